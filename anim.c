@@ -0,0 +1,151 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * anim:  Streaming decoder for keyframe + delta ring animations.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "geometry.h"
+#include "time.h"
+#include "anim.h"
+
+#ifndef NULL
+#define NULL ((void *)0)
+#endif
+
+static struct {
+	const uint8_t	*data;		// Start of stream
+	const uint8_t	*key;		// Keyframe at or before cur
+	const uint8_t	*cur;		// Frame on display
+	uint16_t	frame;
+	uint8_t		mode;
+	uint32_t	due;		// time_getglobal() of the next frame
+} pl;
+
+#define A_PERIOD(a)	((a)[0])
+#define A_FLAGS(a)	((a)[1])
+#define A_FRAMES(a)	((a)[2] | ((a)[3] << 8))
+#define A_FIRST(a)	((a) + 4)
+
+// Animations are 60 pixels; on bigger rings each covers RING_MULT.
+static inline void put(pix_t *fb, int i, const uint8_t *c)
+{
+	for (int j = i * RING_MULT; j < (i + 1) * RING_MULT; j++) {
+		fb[j].r = c[0];
+		fb[j].g = c[1];
+		fb[j].b = c[2];
+	}
+}
+
+// Decode one frame into fb (or just step over it if fb is NULL), returning
+// the start of the next.
+static const uint8_t *decode_frame(const uint8_t *p, pix_t *fb)
+{
+	int i = 0;
+
+	p++;	// Header
+	for (;;) {
+		int op = *p & 0xc0;
+		int n = (*p++ & 0x3f) + 1;
+
+		if (op == ANIM_END)
+			return p;
+		if (op == ANIM_SKIP) {
+			i += n;
+		} else if (op == ANIM_RUN) {
+			if (fb) {
+				for (; n > 0 && i < 60; n--, i++)
+					put(fb, i, p);
+			}
+			p += 3;
+		} else {
+			const uint8_t *next = p + 3*n;
+			if (fb) {
+				for (; n > 0 && i < 60; n--, i++, p += 3)
+					put(fb, i, p);
+			}
+			p = next;
+		}
+	}
+}
+
+void	anim_play(const uint8_t *a, int mode)
+{
+	pl.data = a;
+	pl.key = pl.cur = A_FIRST(a);
+	pl.frame = 0;
+	pl.mode = mode;
+	pl.due = (uint32_t)time_getglobal() + A_PERIOD(a);
+}
+
+void	anim_stop(void)
+{
+	pl.mode = ANIM_IDLE;
+}
+
+int	anim_playing(void)
+{
+	return pl.mode;
+}
+
+// Move on a frame, returning 0 at the end.
+static int	step(void)
+{
+	if (++pl.frame == A_FRAMES(pl.data)) {
+		if (!(A_FLAGS(pl.data) & ANIM_LOOP))
+			return 0;
+		pl.frame = 0;
+		pl.key = pl.cur = A_FIRST(pl.data);
+		return 1;
+	}
+	pl.cur = decode_frame(pl.cur, NULL);
+	if (*pl.cur & ANIM_KEY)
+		pl.key = pl.cur;
+	return 1;
+}
+
+int	anim_draw(pix_t *fb)
+{
+	uint32_t now = (uint32_t)time_getglobal();
+	const uint8_t *p;
+	int behind = 0;
+
+	if (pl.mode == ANIM_IDLE)
+		return 0;
+
+	while ((int32_t)(now - pl.due) >= 0) {
+		if (!step()) {
+			pl.mode = ANIM_IDLE;
+			return 0;
+		}
+		pl.due += A_PERIOD(pl.data);
+		// Badly stalled (e.g. in the debugger); don't try to catch up.
+		if (++behind == A_FRAMES(pl.data))
+			pl.due = now + A_PERIOD(pl.data);
+	}
+
+	if (pl.mode == ANIM_INSTEAD) {
+		int i;
+		for (i = 0; i < RING_PIXELS; i++)
+			fb[i].r = fb[i].g = fb[i].b = 0;
+	}
+
+	// Keyframe, then the deltas up to and including this frame:
+	p = pl.key;
+	while (p != pl.cur)
+		p = decode_frame(p, fb);
+	decode_frame(p, fb);
+	return 1;
+}
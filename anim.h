@@ -0,0 +1,62 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANIM_H
+#define ANIM_H
+
+#include "types.h"
+
+/* Pre-authored animations (boot splash, hour chime), played from the asset
+ * store in flash.
+ *
+ * There's no RAM for a frame of our own, so each refresh the current frame
+ * is rebuilt in the framebuffer by decoding its keyframe and then the deltas
+ * after it.  The encoder (tools/animenc.py) puts in a keyframe at least every
+ * ANIM_MAX_CHAIN frames, which bounds the work per refresh to that many
+ * frames of ops.
+ *
+ * Frames are 60 pixels, stretched over bigger rings.
+ *
+ * Stream:  period (ms per frame), flags, frame count (16 bits, LE), then
+ * the frames.  Each frame is a header byte (ANIM_KEY for a keyframe) and
+ * ops, each a byte with the pixel count less one in the low 6 bits:
+ *	ANIM_SKIP	leave n pixels (transparent in a keyframe)
+ *	ANIM_RUN	r, g, b:  n pixels of one colour
+ *	ANIM_LIT	n * (r, g, b)
+ *	ANIM_END	end of frame
+ */
+
+#define ANIM_MAX_CHAIN	8
+
+#define ANIM_SKIP	0x00
+#define ANIM_RUN	0x40
+#define ANIM_LIT	0x80
+#define ANIM_END	0xc0
+#define ANIM_KEY	0x80	// Frame header
+#define ANIM_LOOP	1	// Flags
+
+enum { ANIM_IDLE, ANIM_OVER, ANIM_INSTEAD };
+
+// Start playing, over the face or instead of it (on black):
+void	anim_play(const uint8_t *a, int mode);
+void	anim_stop(void);
+// ANIM_IDLE if nothing's playing, else the mode:
+int	anim_playing(void);
+// Draw the current frame into fb, stopping at the end of the animation.
+// Returns 0 if nothing was drawn (nothing playing, or it just ended).
+int	anim_draw(pix_t *fb);
+
+#endif
@@ -0,0 +1,62 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * assets:  Read-in-place constant data in flash (see assets.h).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "assets.h"
+
+#ifdef SIM
+#include <stdio.h>
+#else
+#include "uart.h"
+#endif
+
+// The region is 4K (stm32f051x6.ld):
+#define ASSET_REGION	4096
+
+int	assets_init(void)
+{
+	uint32_t count = asset_image[1] >> 16;
+	uint32_t size = asset_image[2];
+	uint32_t sum = 0;
+	unsigned int i;
+	const asset_ent_t *ent = (const asset_ent_t *)&asset_image[4];
+
+	if (asset_image[0] != ASSET_MAGIC ||
+	    (asset_image[1] & 0xffff) != ASSET_VERSION ||
+	    count < ASSET_NUM_IDS ||
+	    size > ASSET_REGION || size < 16 + count * 8 || (size & 3)) {
+		printf("assets: no image\r\n");
+		return 0;
+	}
+	for (i = 4; i < size/4; i++)
+		sum += asset_image[i];
+	if (sum != asset_image[3]) {
+		printf("assets: bad checksum\r\n");
+		return 0;
+	}
+	/* Tables are read in place as halfwords and words, and the M0 faults
+	 * on an unaligned load, so every entry must start on a word:
+	 */
+	for (i = 0; i < count; i++) {
+		if (ent[i].offset > size || ent[i].size > size - ent[i].offset ||
+		    (ent[i].offset & 3)) {
+			printf("assets: bad entry %d\r\n", i);
+			return 0;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,83 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <inttypes.h>
+
+/* Constant tables, faces and animations live in an image of their own in
+ * the ASSETS flash region (see stm32f051x6.ld), built by tools/mkassets.py
+ * from assets/manifest.txt.  It's linked into the firmware but can also be
+ * reflashed on its own ('make flash_assets') without touching the code.
+ *
+ * Assets are read in place:  asset_get() returns a pointer into flash.
+ *
+ * Image layout, little-endian words:
+ *	magic (ASSET_MAGIC)
+ *	version (ASSET_VERSION) | count << 16
+ *	size of the image in bytes
+ *	sum of all the words after the header
+ *	count * { offset from image start, size in bytes }
+ *	blobs, each starting on a word boundary
+ */
+
+#define ASSET_MAGIC	0x53414343	// 'CCAS'
+#define ASSET_VERSION	1
+
+// IDs, in the order of assets/manifest.txt:
+enum {
+	ASSET_SINTAB,		// short[SINTAB_Q_ENTRIES]
+	ASSET_PAL_FIRE,		// palette_t
+	ASSET_PAL_OCEAN,
+	ASSET_FACE_PIE,		// Bytecode faces, see facevm.h
+	ASSET_FACE_PULSE,
+	ASSET_ANIM_SPLASH,	// Animations, see anim.h
+	ASSET_ANIM_CHIME,
+	ASSET_NUM_IDS
+};
+
+#ifdef SIM
+#define ASSET_SECTION
+#else
+#define ASSET_SECTION	__attribute__((section(".assets")))
+#endif
+
+extern const uint32_t asset_image[];
+
+// Check the image; returns 0 if it's missing or corrupt, in which case
+// nothing can be drawn.
+int	assets_init(void);
+
+typedef struct {
+	uint32_t	offset;
+	uint32_t	size;
+} asset_ent_t;
+
+// Only valid after assets_init() has succeeded, and for ids it checked:
+static inline const void *asset_get(unsigned int id)
+{
+	const asset_ent_t *ent = (const asset_ent_t *)&asset_image[4];
+	return (const uint8_t *)asset_image + ent[id].offset;
+}
+
+static inline uint32_t asset_size(unsigned int id)
+{
+	const asset_ent_t *ent = (const asset_ent_t *)&asset_image[4];
+	return ent[id].size;
+}
+
+#endif
@@ -0,0 +1,377 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * bench:  Time the per-frame kernels in TIM2 (48MHz) cycles.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "geometry.h"
+#include "time.h"
+#include "bench.h"
+#include "ss_ring.h"
+#include "trail.h"
+#include "lookuptables.h"
+#include "fixmath.h"
+#include "colour.h"
+#include "display_effects.h"
+#include "anim.h"
+#include "assets.h"
+#include "tod.h"
+
+#ifdef SIM
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#else
+#include "uart.h"
+#include "led_disp.h"
+#endif
+
+#define BENCH_ITERS	64
+
+static void	report(const char *name, uint32_t t)
+{
+	printf("bench %s: %d cycles\r\n", name, t / BENCH_ITERS);
+}
+
+// Numbers measured on the STM32F051 @48MHz go in the comments.
+
+static void	bench_ss_ring(void)
+{
+	ss_ring_t ring;
+	pix_t fb[RING_PIXELS];
+	const pix_t c = { 255, 128, 64 };
+	uint32_t t;
+
+	for (int i = 0; i < RING_PIXELS; i++)
+		fb[i].r = fb[i].g = fb[i].b = 0;
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++) {
+		ss_clear(&ring);
+		ss_arc(&ring, i * 7, 24);
+	}
+	report("ss_clear+arc", time_getfine() - t);
+
+	// Worst case for resolve: every pixel partly covered.
+	for (int i = 0; i < RING_PIXELS; i++)
+		ring.cov[i] = 0x5a;
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		ss_resolve(fb, &ring, c, SS_BOX);
+	report("ss_resolve box", time_getfine() - t);
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		ss_resolve(fb, &ring, c, SS_TENT);
+	report("ss_resolve tent", time_getfine() - t);
+}
+
+static void	bench_trail(void)
+{
+	pix_t fb[RING_PIXELS];
+	uint32_t t;
+
+	trail_reset();
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++) {
+		// A moving dot over black, so both decay and max() paths run:
+		for (int j = 0; j < RING_PIXELS; j++)
+			fb[j].r = fb[j].g = fb[j].b = (j == i) ? 255 : 0;
+		trail_apply(fb, 6);
+	}
+	report("trail_apply (incl. fill)", time_getfine() - t);
+}
+
+// Stops the compiler throwing away results:
+static volatile uint32_t sink;
+
+static void	bench_math(void)
+{
+	uint32_t t, acc = 0;
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		acc += SIN(i * 7);
+	report("SIN", time_getfine() - t);
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		acc += SIN16(i * 1031);
+	report("SIN16", time_getfine() - t);
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		acc += fx_recip(i * 1021 + 1);
+	report("fx_recip", time_getfine() - t);
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		acc += fx_decay(i * 61);
+	report("fx_decay", time_getfine() - t);
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		acc += fx_isqrt((uint32_t)i * 67108863);
+	report("fx_isqrt", time_getfine() - t);
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		acc += fx_smoothstep(i * 1024);
+	report("fx_smoothstep", time_getfine() - t);
+
+	sink = acc;
+
+#ifdef SIM
+	// Accuracy against libm, exhaustively where that's cheap:
+	double err, max_err = 0;
+
+	for (int a = 0; a < 0x10000; a++) {
+		err = fabs(SIN16(a) - 32767.0 * sin(a * 2 * M_PI / 65536));
+		if (err > max_err)
+			max_err = err;
+	}
+	printf("check SIN16: max err %.2f LSB\n", max_err);
+
+	// Relative error, less the integer rounding that dominates for big d:
+	max_err = 0;
+	for (int d = 1; d < 0x10000; d++) {
+		double exact = 16777216.0 / d;
+		err = (fabs(fx_recip(d) - exact) - 1) / exact;
+		if (err > max_err)
+			max_err = err;
+	}
+	printf("check fx_recip: max rel err %.6f (+1 LSB)\n", max_err);
+
+	max_err = 0;
+	for (int x = 0; x < 16*256; x++) {
+		err = fabs(fx_decay(x) - 65535.0 * pow(2, -x / 256.0));
+		if (err > max_err)
+			max_err = err;
+	}
+	printf("check fx_decay: max err %.2f LSB\n", max_err);
+
+	int bad = 0;
+	for (uint32_t x = 0; x < 0xffffff00; x += 0x10001) {
+		uint32_t r = fx_isqrt(x);
+		if ((uint64_t)r*r > x || (uint64_t)(r+1)*(r+1) <= x)
+			bad++;
+	}
+	printf("check fx_isqrt: %d wrong\n", bad);
+
+	max_err = 0;
+	for (int x = 0; x <= 65536; x++) {
+		double xf = x / 65536.0;
+		err = fabs(fx_smoothstep(x) - 65536.0 * xf*xf*(3 - 2*xf));
+		if (err > max_err)
+			max_err = err;
+	}
+	printf("check fx_smoothstep: max err %.2f LSB\n", max_err);
+#endif
+}
+
+static void	bench_colour(void)
+{
+	pix_t fb[RING_PIXELS];
+	tod_t tod = { 10, 10, 30, 0, 1, 0 };
+	uint32_t t, acc = 0;
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		acc += colour_hue(i * 5).g;
+	report("colour_hue", time_getfine() - t);
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		acc += colour_palette(asset_get(ASSET_PAL_FIRE), i * 5).g;
+	report("colour_palette", time_getfine() - t);
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		acc += colour_sv(colour_hue(i), i, 255 - i).g;
+	report("colour_hue+sv", time_getfine() - t);
+
+	sink = acc;
+
+	// Whole face, the thing that has to fit in the frame budget:
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++) {
+		tod.frac = i << 10;
+		d_rainbow(fb, i << 10, &tod, 1);
+	}
+	report("d_rainbow face", time_getfine() - t);
+}
+
+// The bytecode pie against the native one it copies:
+static void	bench_facevm(void)
+{
+	pix_t fb[RING_PIXELS];
+	tod_t tod = { 10, 10, 30, 0, 1, 0 };
+	uint32_t t;
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++) {
+		tod.frac = i << 10;
+		d_pie(fb, 0, &tod, 3);
+	}
+	report("d_pie native", time_getfine() - t);
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++) {
+		tod.frac = i << 10;
+		d_vm(fb, 0, &tod, VM_FACE(0) | 3);
+	}
+	report("d_pie bytecode", time_getfine() - t);
+
+#if defined(SIM) && RING_MULT == 1	// (faces/pie.fvs assumes 60 pixels)
+	{
+		pix_t ref[RING_PIXELS];
+		int worst = 0;
+
+		for (int i = 0; i < 3600; i += 7) {
+			tod.min = i / 60;
+			tod.sec = i % 60;
+			tod.frac = i * 331;
+			d_pie(ref, 0, &tod, 3);
+			d_vm(fb, 0, &tod, VM_FACE(0) | 3);
+			for (int j = 0; j < RING_PIXELS; j++) {
+				int d = abs(ref[j].r - fb[j].r) +
+					abs(ref[j].g - fb[j].g) +
+					abs(ref[j].b - fb[j].b);
+				if (d > worst)
+					worst = d;
+			}
+		}
+		printf("check d_pie bytecode: worst pixel diff %d\n", worst);
+	}
+#endif
+}
+
+// Worst case is a keyframe and a full chain of deltas after it; in the
+// splash that's frame 7, so let it play that far first.
+static void	bench_anim(void)
+{
+	pix_t fb[RING_PIXELS];
+	const uint8_t *splash = asset_get(ASSET_ANIM_SPLASH);
+	uint32_t t = (uint32_t)time_getglobal();
+
+	anim_play(splash, ANIM_INSTEAD);
+	while ((uint32_t)time_getglobal() - t < 7U * splash[0] + 2)
+		;
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		anim_draw(fb);
+	report("anim_draw chain", time_getfine() - t);
+	anim_stop();
+}
+
+// The way the fast clocks used to work, for comparison:  TOD from a count of
+// microseconds, with 64-bit divides.
+static void	tod_from_us(uint64_t tus, tod_t *time_out)
+{
+	time_out->hour 	= ((tus/1000000) % (12*60*60)) / (60*60);
+	time_out->min  	= ((tus/1000000) % (60*60)) / 60;
+	time_out->sec 	= (tus/1000000) % 60;
+	time_out->frac 	= time_us_to_frac(tus % 1000000);
+	time_out->subsec = time_out->frac >> 10;
+	time_out->amnpm = ((tus/1000000) % (24*60*60)) < 12*60*60;
+}
+
+static void	bench_tod(void)
+{
+	// A 60Hz frame, at 60x:
+	const uint32_t step = 16667 * 60;
+	tod_counter_t c;
+	tod_t tod;
+	uint64_t tus = 0;
+	uint32_t t;
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++) {
+		tus += step;
+		tod_from_us(tus, &tod);
+	}
+	report("tod divides", time_getfine() - t);
+
+	tod_counter_set(&c, 0, 0, 0, 0);
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++) {
+		tod_counter_step(&c, step);
+		tod_counter_get(&c, &tod);
+	}
+	report("tod_counter_step+get", time_getfine() - t);
+
+	sink = tod.frac;
+
+#ifdef SIM
+	// Against the divides, over a few weeks of odd-sized steps:
+	tod_t ref;
+	int bad = 0;
+
+	tus = 0;
+	tod_counter_set(&c, 0, 0, 0, 0);
+	for (uint32_t i = 0; i < 1000000; i++) {
+		uint32_t s = (i * 2654435761U) >> (i & 31);
+
+		if (s > TOD_MAX_STEP_US)
+			s = TOD_MAX_STEP_US;
+		tus += s;
+		tod_counter_step(&c, s);
+		tod_counter_get(&c, &tod);
+		tod_from_us(tus, &ref);
+		// (Field by field; memcmp() would see tod_t's padding.)
+		if (tod.hour != ref.hour || tod.min != ref.min ||
+		    tod.sec != ref.sec || tod.subsec != ref.subsec ||
+		    tod.frac != ref.frac || tod.amnpm != ref.amnpm)
+			bad++;
+	}
+	printf("check tod_counter: %d wrong\n", bad);
+#endif
+}
+
+#ifndef SIM
+// The other half of each frame's work.  (Before led_disp_init(), so this
+// only scribbles on a buffer that's cleared afterwards.)
+static void	bench_encode(void)
+{
+	pix_t fb[RING_PIXELS];
+	uint32_t t;
+
+	for (int i = 0; i < RING_PIXELS; i++)
+		fb[i].r = fb[i].g = fb[i].b = i * 4;
+
+	t = time_getfine();
+	for (int i = 0; i < BENCH_ITERS; i++)
+		led_fb_to_pwm_buffer(fb);
+	report("led_fb_to_pwm_buffer", time_getfine() - t);
+}
+#endif
+
+void	bench_run(void)
+{
+	// Render and encode costs go with pixel count:
+	printf("bench: %d pixels\r\n", RING_PIXELS);
+	bench_ss_ring();
+	bench_trail();
+	bench_math();
+	bench_colour();
+	bench_facevm();
+	bench_anim();
+	bench_tod();
+#ifndef SIM
+	bench_encode();
+#endif
+}
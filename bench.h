@@ -0,0 +1,26 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/* Micro-benchmarks of the per-frame kernels, printed to the UART (or stdout
+ * in the sim).  Built with 'make BENCH=1'; run before the LED scan IRQs are
+ * started so they don't steal cycles.
+ */
+void	bench_run(void);
+
+#endif
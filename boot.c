@@ -0,0 +1,49 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * boot:  Boot phase timing (see boot.h).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "boot.h"
+#include "hw.h"
+#include "time.h"
+#include "rtc.h"
+#include "uart.h"	// for printf
+
+boot_mark_t	boot_marks[BOOT_MARKS];
+static uint8_t	nmarks;
+
+void	boot_mark(const char *what)
+{
+	if (nmarks < BOOT_MARKS) {
+		boot_marks[nmarks].what = what;
+		boot_marks[nmarks].cycles = time_getfine();
+		nmarks++;
+	}
+}
+
+void	boot_report(void)
+{
+	uint32_t last = 0;
+
+	printf("boot (%s):\r\n", rtc_warm_boot() ? "warm" : "cold");
+	// Once, so the divides don't matter:
+	for (int i = 0; i < nmarks; i++) {
+		printf("  %s: %dus (+%dus)\r\n", boot_marks[i].what,
+		       (int)(boot_marks[i].cycles / (SYS_CLK / 1000000)),
+		       (int)((boot_marks[i].cycles - last) / (SYS_CLK / 1000000)));
+		last = boot_marks[i].cycles;
+	}
+}
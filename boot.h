@@ -0,0 +1,42 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <inttypes.h>
+
+/* Boot phase markers:  each is stamped with TIM2 (so from time_init(),
+ * just after the PLL's locked) and kept in boot_marks[] for a debugger to
+ * look at.  boot_report() prints them, once the first frame's out.
+ */
+#define BOOT_MARKS	16
+
+typedef struct {
+	const char	*what;
+	uint32_t	cycles;
+} boot_mark_t;
+
+extern boot_mark_t	boot_marks[BOOT_MARKS];
+
+#ifdef SIM
+#define boot_mark(what)
+#else
+void	boot_mark(const char *what);
+void	boot_report(void);
+#endif
+
+#endif
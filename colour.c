@@ -0,0 +1,77 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * colour:  Hue wheel, palettes and saturation/brightness for faces.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "colour.h"
+
+// HSV(i/64, 1, 1):
+static const pix_t hue_wheel[64] = {
+	{ 255,   0,   0 }, { 255,  24,   0 }, { 255,  48,   0 }, { 255,  72,   0 },
+	{ 255,  96,   0 }, { 255, 120,   0 }, { 255, 143,   0 }, { 255, 167,   0 },
+	{ 255, 191,   0 }, { 255, 215,   0 }, { 255, 239,   0 }, { 247, 255,   0 },
+	{ 223, 255,   0 }, { 199, 255,   0 }, { 175, 255,   0 }, { 151, 255,   0 },
+	{ 128, 255,   0 }, { 104, 255,   0 }, {  80, 255,   0 }, {  56, 255,   0 },
+	{  32, 255,   0 }, {   8, 255,   0 }, {   0, 255,  16 }, {   0, 255,  40 },
+	{   0, 255,  64 }, {   0, 255,  88 }, {   0, 255, 112 }, {   0, 255, 135 },
+	{   0, 255, 159 }, {   0, 255, 183 }, {   0, 255, 207 }, {   0, 255, 231 },
+	{   0, 255, 255 }, {   0, 231, 255 }, {   0, 207, 255 }, {   0, 183, 255 },
+	{   0, 159, 255 }, {   0, 135, 255 }, {   0, 112, 255 }, {   0,  88, 255 },
+	{   0,  64, 255 }, {   0,  40, 255 }, {   0,  16, 255 }, {   8,   0, 255 },
+	{  32,   0, 255 }, {  56,   0, 255 }, {  80,   0, 255 }, { 104,   0, 255 },
+	{ 128,   0, 255 }, { 151,   0, 255 }, { 175,   0, 255 }, { 199,   0, 255 },
+	{ 223,   0, 255 }, { 247,   0, 255 }, { 255,   0, 239 }, { 255,   0, 215 },
+	{ 255,   0, 191 }, { 255,   0, 167 }, { 255,   0, 143 }, { 255,   0, 120 },
+	{ 255,   0,  96 }, { 255,   0,  72 }, { 255,   0,  48 }, { 255,   0,  24 }
+};
+
+// a + (b-a)*f/2^shift, per channel
+static inline pix_t lerp(pix_t a, pix_t b, int f, int shift)
+{
+	pix_t o;
+
+	o.r = a.r + (((b.r - a.r) * f) >> shift);
+	o.g = a.g + (((b.g - a.g) * f) >> shift);
+	o.b = a.b + (((b.b - a.b) * f) >> shift);
+	return o;
+}
+
+pix_t	colour_hue(uint8_t h)
+{
+	int i = h >> 2;
+
+	return lerp(hue_wheel[i], hue_wheel[(i + 1) & 63], h & 3, 2);
+}
+
+pix_t	colour_palette(const palette_t *p, uint8_t pos)
+{
+	int i = pos >> 4;
+
+	return lerp(p->c[i], p->c[(i + 1) & (PALETTE_ENTRIES-1)], pos & 15, 4);
+}
+
+pix_t	colour_sv(pix_t c, uint8_t s, uint8_t v)
+{
+	// s/v+1 so that 255 leaves the colour alone and /256 is a shift:
+	int sm = s + 1;
+	int vm = v + 1;
+
+	c.r = ((255 - (((255 - c.r) * sm) >> 8)) * vm) >> 8;
+	c.g = ((255 - (((255 - c.g) * sm) >> 8)) * vm) >> 8;
+	c.b = ((255 - (((255 - c.b) * sm) >> 8)) * vm) >> 8;
+	return c;
+}
@@ -0,0 +1,44 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLOUR_H
+#define COLOUR_H
+
+#include "types.h"
+
+/* Colour engine for faces:  no divides, so cheap enough per pixel per frame.
+ *
+ * Hue is 0-255 around the wheel (red at 0), looked up in a 64-entry table and
+ * interpolated.  Palettes are 16-entry gradients, looked up with a 0-255
+ * position, likewise interpolated; they wrap from the last entry to the first
+ * so can be used round the ring.  Palettes are kept in the asset store
+ * (assets/NAME.pal).
+ */
+
+#define PALETTE_ENTRIES	16
+
+typedef struct {
+	pix_t	c[PALETTE_ENTRIES];
+} palette_t;
+
+
+// Fully-saturated, full-value colour of hue h:
+pix_t	colour_hue(uint8_t h);
+pix_t	colour_palette(const palette_t *p, uint8_t pos);
+// Saturation (0 = white) and value/brightness (0 = black) applied to c:
+pix_t	colour_sv(pix_t c, uint8_t s, uint8_t v);
+
+#endif
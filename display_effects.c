@@ -18,19 +18,30 @@
  */
 
 #include "types.h"
+#include "geometry.h"
 #include "rtc.h"
 #include "lookuptables.h"
 #include "display_effects.h"
+#include "ss_ring.h"
+#include "trail.h"
+#include "colour.h"
+#include "facevm.h"
+#include "assets.h"
+#include "time.h"
 
 #ifdef SIM
 #include <stdlib.h>
+#include <stdio.h>
 #else
 #include <stm32f0xx_rtc.h>
+#include "uart.h"
 #endif
 
 static unsigned int current_disp = 0;
 
-typedef void (*dispfunc)(pix_t *fb, unsigned int framenum, tod_t *time, int param);
+// anim is a monotonic time in 1/65536s for animation (see anim_time()), so
+// effects run at the same speed whatever the frame rate.
+typedef void (*dispfunc)(pix_t *fb, uint32_t anim, tod_t *time, int param);
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -48,7 +59,7 @@ static uint8_t sat_add8(uint8_t a, uint8_t b)
 void d_ticks(pix_t *fb, int bright)
 {
 	int i;
-	for (i = 0; i < 60; i += 15) {
+	for (i = 0; i < RING_PIXELS; i += RING_PIXELS/4) {
 		int j = (i == 0) ? bright : bright/4;
 		fb[i].r = sat_add8(fb[i].r, j);
 		fb[i].g = sat_add8(fb[i].g, j);
@@ -56,28 +67,39 @@ void d_ticks(pix_t *fb, int bright)
 	}
 }
 
-void d_pie(pix_t *fb, unsigned int framenum, tod_t *time, int param)
+// Hand angles from TDC in 1/256 pixel (0 to RING_PIXELS*256-1).  Uses the
+// fine fraction of the second, so the hands sweep rather than step.
+static void hand_pos(tod_t *time, int *h, int *m, int *s)
+{
+	// In 1/256 of a minute mark first:
+	int sec = time->sec*256 + (time->frac >> 8);
+	int min = time->min*256 + (sec/60);
+
+	*s = sec * RING_MULT;
+	*m = min * RING_MULT;
+	*h = ((5*time->hour*256) + (5 * min/60)) * RING_MULT;
+}
+
+void d_pie(pix_t *fb, uint32_t anim, tod_t *time, int param)
 {
 	int 		i;
-	const int	piewidth = 12;
+	const int	piewidth = 12 * RING_MULT;
 	int		h, m, s;
 	int		st_s, st_m, st_h;
 	int 		fr_s, fr_m, fr_h;
 
 	// Convert the time into angular quantities from TDC:
-	s = time->sec*64 + time->subsec;	// 60*64
-	m = time->min*64 + (s/60);	       	// 60*64
-	h = (5*time->hour*64) + (5*m/60);      	// 60*64
+	hand_pos(time, &h, &m, &s);
 
-	// Start points and fractions for each of the hands.
-	st_s = (s/64);
-	st_m = (m/64);
-	st_h = (h/64);
+	// Start points and fractions (0-255) for each of the hands.
+	st_s = (s >> 8);
+	st_m = (m >> 8);
+	st_h = (h >> 8);
 
 	if (param & 2) {
-		fr_s = s % 64;
-		fr_m = m % 64;
-		fr_h = h % 64;
+		fr_s = s & 0xff;
+		fr_m = m & 0xff;
+		fr_h = h & 0xff;
 	} else {
 		// A 'sharp' tick: just ignore the fractional mid-pixel
 		// position:
@@ -87,7 +109,7 @@ void d_pie(pix_t *fb, unsigned int framenum, tod_t *time, int param)
 	}
 
 	// Draw on a black background:
-	for (i = 0; i < 60; i++) {
+	for (i = 0; i < RING_PIXELS; i++) {
 		int j;
 
 		fb[i].r = 0;
@@ -97,44 +119,44 @@ void d_pie(pix_t *fb, unsigned int framenum, tod_t *time, int param)
 
 	// Hours
 	for (i = 0; i < piewidth; i++) {
-		int br_h = 255 - (i * (256/piewidth) + ((fr_h*256/piewidth)/64));
-		int p_h = (st_h - i) % 60;
+		int br_h = 255 - (i * (256/piewidth) + (fr_h/piewidth));
+		int p_h = (st_h - i) % RING_PIXELS;
 		if (p_h < 0)
-			p_h += 60;
+			p_h += RING_PIXELS;
 		fb[p_h].r = br_h;
 	}
 	// An extra leading edge pixel, if we're not exactly on a tick:
 	if (fr_h) {
-		int p_h = (st_h + 1) % 60;
-		fb[p_h].r = fr_h * 4;
+		int p_h = (st_h + 1) % RING_PIXELS;
+		fb[p_h].r = fr_h;
 	}
 
 	// Mins
 	for (i = 0; i < piewidth; i++) {
-		int br_m = 255 - (i * (256/piewidth) + ((fr_m*256/piewidth)/64));
-		int p_m = (st_m - i) % 60;
+		int br_m = 255 - (i * (256/piewidth) + (fr_m/piewidth));
+		int p_m = (st_m - i) % RING_PIXELS;
 		if (p_m < 0)
-			p_m += 60;
+			p_m += RING_PIXELS;
 		fb[p_m].g = br_m;
 	}
 	// An extra leading edge pixel, if we're not exactly on a tick:
 	if (fr_m) {
-		int p_m = (st_m + 1) % 60;
-		fb[p_m].g = fr_m * 4;
+		int p_m = (st_m + 1) % RING_PIXELS;
+		fb[p_m].g = fr_m;
 	}
 
 	// Secs
 	for (i = 0; i < piewidth; i++) {
-		int br_s = 255 - (i * (256/piewidth) + ((fr_s*256/piewidth)/64));
-		int p_s = (st_s - i) % 60;
+		int br_s = 255 - (i * (256/piewidth) + (fr_s/piewidth));
+		int p_s = (st_s - i) % RING_PIXELS;
 		if (p_s < 0)
-			p_s += 60;
+			p_s += RING_PIXELS;
 		fb[p_s].b = br_s;
 	}
 	// An extra leading edge pixel, if we're not exactly on a tick:
 	if (fr_s) {
-		int p_s = (st_s + 1) % 60;
-		fb[p_s].b = fr_s * 4;
+		int p_s = (st_s + 1) % RING_PIXELS;
+		fb[p_s].b = fr_s;
 	}
 
 	if (param & 1) {
@@ -142,27 +164,29 @@ void d_pie(pix_t *fb, unsigned int framenum, tod_t *time, int param)
 	}
 }
 
-void d_simple_soft(pix_t *fb, unsigned int framenum, tod_t *time, int param)
+void d_simple_soft(pix_t *fb, uint32_t anim, tod_t *time, int param)
 {
 	int i;
 
-	int bi = 8+((8*SIN(framenum))>>SINTAB_SHIFT);
-	int bj = 8+((8*SIN(framenum*2))>>SINTAB_SHIFT);
-	int bk = 8+((8*SIN(framenum*3))>>SINTAB_SHIFT);
+	// One sine period every 2s:
+	unsigned int t = anim >> 8;
+	int bi = 8+((8*SIN(t))>>SINTAB_SHIFT);
+	int bj = 8+((8*SIN(t*2))>>SINTAB_SHIFT);
+	int bk = 8+((8*SIN(t*3))>>SINTAB_SHIFT);
 
 
 #ifdef PSYCHEDELIC_BACKGROUND_BUT_WEIRD_ON_LEDS
-	for (i = 0; i < 60; i++) {
+	for (i = 0; i < RING_PIXELS; i++) {
 		int c;
-		c = bi+((16*SIN(framenum + (5*i*SINTAB_ENTRIES/60))>>SINTAB_SHIFT));
+		c = bi+((16*SIN(t + (5*i*SINTAB_ENTRIES/RING_PIXELS))>>SINTAB_SHIFT));
 		fb[i].r = c > 0 ? c : 0;
-		c = bj+((16*SIN(framenum + (2*i*SINTAB_ENTRIES/60))>>SINTAB_SHIFT));
+		c = bj+((16*SIN(t + (2*i*SINTAB_ENTRIES/RING_PIXELS))>>SINTAB_SHIFT));
 		fb[i].g = c > 0 ? c : 0;
-		c = bk+((16*SIN(framenum + (3*i*SINTAB_ENTRIES/60))>>SINTAB_SHIFT));
+		c = bk+((16*SIN(t + (3*i*SINTAB_ENTRIES/RING_PIXELS))>>SINTAB_SHIFT));
 		fb[i].b = c > 0 ? c : 0;
 	}
 #else
-	for (i = 0; i < 60; i++) {
+	for (i = 0; i < RING_PIXELS; i++) {
 		fb[i].r = 0;
 		fb[i].g = 0;
 		fb[i].b = 0;
@@ -170,33 +194,31 @@ void d_simple_soft(pix_t *fb, unsigned int framenum, tod_t *time, int param)
 #endif
 
 	if (param & 2) {
-		// h/m/s as 6-bit fraction
+		// h/m/s as 8-bit fraction
 		int h, m, s;
 
-		s = time->sec*64 + time->subsec;	// 60*64
-		m = time->min*64 + (s/60);	       	// 60*64
-		h = time->hour*5*64 + (5*m/60);		// 12*64
+		hand_pos(time, &h, &m, &s);
 
 		int j,k;
 
-		j = s / 64;	// First LED this tick is present on
-		k = s % 64;	// How far between
-		fb[j].b = sat_add8(fb[j].b, 255*(64-k)/64);
-		fb[(j+1) % 60].b = sat_add8(fb[(j+1) % 60].b, 255*k/64);
+		j = s >> 8;	// First LED this tick is present on
+		k = s & 0xff;	// How far between
+		fb[j].b = sat_add8(fb[j].b, (255*(256-k)) >> 8);
+		fb[(j+1) % RING_PIXELS].b = sat_add8(fb[(j+1) % RING_PIXELS].b, (255*k) >> 8);
 
-		j = m / 64;
-		k = m % 64;
-		fb[j].g = sat_add8(fb[j].g, 255*(64-k)/64);
-		fb[(j+1) % 60].g = sat_add8(fb[(j+1) % 60].g, 255*k/64);
+		j = m >> 8;
+		k = m & 0xff;
+		fb[j].g = sat_add8(fb[j].g, (255*(256-k)) >> 8);
+		fb[(j+1) % RING_PIXELS].g = sat_add8(fb[(j+1) % RING_PIXELS].g, (255*k) >> 8);
 
-		j = h / 64;
-		k = h % 64;
-		fb[j].r = sat_add8(fb[j].r, 255*(64-k)/64);
-		fb[(j+1) % 60].r = sat_add8(fb[(j+1) % 60].r, 255*k/64);
+		j = h >> 8;
+		k = h & 0xff;
+		fb[j].r = sat_add8(fb[j].r, (255*(256-k)) >> 8);
+		fb[(j+1) % RING_PIXELS].r = sat_add8(fb[(j+1) % RING_PIXELS].r, (255*k) >> 8);
 	} else {
-		fb[time->sec].b = 255;
-		fb[time->min].g = 255;
-		fb[((time->hour * 60) + time->min)/12].r = 255;
+		fb[time->sec * RING_MULT].b = 255;
+		fb[time->min * RING_MULT].g = 255;
+		fb[(((time->hour * 60) + time->min)/12) * RING_MULT].r = 255;
 	}	
 
 	if (param & 1) {
@@ -204,20 +226,19 @@ void d_simple_soft(pix_t *fb, unsigned int framenum, tod_t *time, int param)
 	}
 }
 
-void d_blob_soft(pix_t *fb, unsigned int framenum, tod_t *time, int param)
+void d_blob_soft(pix_t *fb, uint32_t anim, tod_t *time, int param)
 {
 	int i;
 	int h, m, s;
 
-	// 9 looks good/smooth, but is a bit too vague for time-telling:
-	const int blobwidth = 7;
+	// 9 looks good/smooth, but is a bit too vague for time-telling (kept
+	// odd on bigger rings, so there's a middle pixel):
+	const int blobwidth = 6 * RING_MULT + 1;
 
 	// Convert the time into angular quantities from TDC:
-	s = time->sec*64 + time->subsec;	// 60*64
-	m = time->min*64 + (s/60);	       	// 60*64
-	h = (5*time->hour*64) + (5*m/60);      	// 60*64
+	hand_pos(time, &h, &m, &s);
 
-	for (i = 0; i < 60; i++) {
+	for (i = 0; i < RING_PIXELS; i++) {
 		fb[i].r = 0;
 		fb[i].g = 0;
 		fb[i].b = 0;
@@ -225,40 +246,41 @@ void d_blob_soft(pix_t *fb, unsigned int framenum, tod_t *time, int param)
 
 	// Start points and fractions for each of the hands.  The mid-point of
 	// the blob is the 'hand' position!
-	int st_s = (s/64) - (blobwidth/2);
-	int fr_s = s % 64;
-	int st_m = (m/64) - (blobwidth/2);
-	int fr_m = m % 64;
-	int st_h = (h/64) - (blobwidth/2);
-	int fr_h = h % 64;
+	int st_s = (s >> 8) - (blobwidth/2);
+	int fr_s = s & 0xff;
+	int st_m = (m >> 8) - (blobwidth/2);
+	int fr_m = m & 0xff;
+	int st_h = (h >> 8) - (blobwidth/2);
+	int fr_h = h & 0xff;
 
 	// Offset '0' always outputs brightness value 0, so don't need to start
 	// at index 0.
 	for (i = 1; i < blobwidth; i++) {
 		int br_h, br_m, br_s;
-		// 270 to 270
-		int theta = (SINTAB_ENTRIES*3/4) + ((i*(SINTAB_ENTRIES))/(blobwidth-1));
+		// 270 to 270, in 1/65536 turn (interpolated, so the blob
+		// doesn't jitter as it moves):
+		int theta = 0xc000 + ((i*0x10000)/(blobwidth-1));
 		int t_h, t_m, t_s;
 
-		t_h = theta - (fr_h*SINTAB_ENTRIES)/((blobwidth-1)*64);
-		t_m = theta - (fr_m*SINTAB_ENTRIES)/((blobwidth-1)*64);
-		t_s = theta - (fr_s*SINTAB_ENTRIES)/((blobwidth-1)*64);
+		t_h = theta - (fr_h << 8)/(blobwidth-1);
+		t_m = theta - (fr_m << 8)/(blobwidth-1);
+		t_s = theta - (fr_s << 8)/(blobwidth-1);
 
-		br_h = 128+((128*SIN(t_h))>>SINTAB_SHIFT);
-		br_m = 128+((128*SIN(t_m))>>SINTAB_SHIFT);
-		br_s = 128+((128*SIN(t_s))>>SINTAB_SHIFT);
+		br_h = 128+((128*SIN16(t_h))>>SINTAB_SHIFT);
+		br_m = 128+((128*SIN16(t_m))>>SINTAB_SHIFT);
+		br_s = 128+((128*SIN16(t_s))>>SINTAB_SHIFT);
 
-		int p_h = (st_h + i) % 60;
+		int p_h = (st_h + i) % RING_PIXELS;
 		if (p_h < 0)
-			p_h += 60;
+			p_h += RING_PIXELS;
 
-		int p_m = (st_m + i) % 60;
+		int p_m = (st_m + i) % RING_PIXELS;
 		if (p_m < 0)
-			p_m += 60;
+			p_m += RING_PIXELS;
 
-		int p_s = (st_s + i) % 60;
+		int p_s = (st_s + i) % RING_PIXELS;
 		if (p_s < 0)
-			p_s += 60;
+			p_s += RING_PIXELS;
 
 		fb[p_h].r = br_h;
 		fb[p_m].g = br_m;
@@ -270,11 +292,11 @@ void d_blob_soft(pix_t *fb, unsigned int framenum, tod_t *time, int param)
 	}
 }
 
-void d_minimale(pix_t *fb, unsigned int framenum, tod_t *time, int param)
+void d_minimale(pix_t *fb, uint32_t anim, tod_t *time, int param)
 {
 	int i;
 
-	for (i = 0; i < 60; i++) {
+	for (i = 0; i < RING_PIXELS; i++) {
 		int bri = 0;
 
 		if (i == 0) {
@@ -282,13 +304,13 @@ void d_minimale(pix_t *fb, unsigned int framenum, tod_t *time, int param)
 			fb[0].g	= 0;
 			fb[0].b	= 0;
 		} else {
-			if (i <= (((time->hour * 60) + time->min)/12)) {
-				if (i % 5 == 0)
+			if (i <= (((time->hour * 60) + time->min)/12) * RING_MULT) {
+				if (i % (5 * RING_MULT) == 0)
 					bri = 96;
 				else
 					bri = 255;
 			} else {
-				if (i % 5 == 0)
+				if (i % (5 * RING_MULT) == 0)
 					bri = 4;
 			}
 
@@ -299,27 +321,254 @@ void d_minimale(pix_t *fb, unsigned int framenum, tod_t *time, int param)
 	}
 }
 
+// Hands as arcs on the supersampled ring, so they glide smoothly between
+// pixels.  param bit 0 = ticks, bit 1 = tent filter (softer) rather than box.
+void d_arcs(pix_t *fb, uint32_t anim, tod_t *time, int param)
+{
+	int i;
+	int h, m, s;
+	ss_ring_t ring;
+	const pix_t c_h = { 255, 0, 0 };
+	const pix_t c_m = { 0, 255, 0 };
+	const pix_t c_s = { 0, 0, 255 };
+	int filter = (param & 2) ? SS_TENT : SS_BOX;
+
+	// Positions in 1/8 pixel:
+	hand_pos(time, &h, &m, &s);
+	s >>= 5;
+	m >>= 5;
+	h >>= 5;
+
+	for (i = 0; i < RING_PIXELS; i++) {
+		fb[i].r = 0;
+		fb[i].g = 0;
+		fb[i].b = 0;
+	}
+
+	// Widths in 1/8 pixels, centred on the hand (pixel centre is +4):
+	ss_clear(&ring);
+	ss_arc(&ring, h + 4 - 12 * RING_MULT, 24 * RING_MULT);
+	ss_resolve(fb, &ring, c_h, filter);
+
+	ss_clear(&ring);
+	ss_arc(&ring, m + 4 - 8 * RING_MULT, 16 * RING_MULT);
+	ss_resolve(fb, &ring, c_m, filter);
+
+	ss_clear(&ring);
+	ss_arc(&ring, s + 4 - 4 * RING_MULT, 8 * RING_MULT);
+	ss_resolve(fb, &ring, c_s, filter);
+
+	if (param & 1) {
+		d_ticks(fb, 32);
+	}
+}
+
+// Distance round the ring between two positions in 1/256 pixel:
+static int ring_dist(int a, int b)
+{
+	int d = a - b;
+
+	if (d < 0)
+		d = -d;
+	if (d > RING_PIXELS*128)
+		d = RING_PIXELS*256 - d;
+	return d;
+}
+
+// Colour wheel face:  a dim, slowly turning hue wheel with the hands lit up
+// in the colour beneath them; the second hand is washed towards white.
+// param bit 0 = ticks, bit 1 = fire palette instead of the hue wheel.
+void d_rainbow(pix_t *fb, uint32_t anim, tod_t *time, int param)
+{
+	int i;
+	int h, m, s;
+	// One turn of the wheel every 64s:
+	int rot = anim >> 14;
+	const palette_t *pal = asset_get(ASSET_PAL_FIRE);
+
+	hand_pos(time, &h, &m, &s);
+
+	for (i = 0; i < RING_PIXELS; i++) {
+		int p = i << 8;
+		uint8_t pos = ((i * (65536 / RING_PIXELS)) >> 8) + rot;
+		// Hour 2 minute marks either side, the others 1:
+		int vh = 255 - ring_dist(p, h) / (2 * RING_MULT);
+		int vm = 255 - ring_dist(p, m) / RING_MULT;
+		int vs = 255 - ring_dist(p, s) / RING_MULT;
+		int v = 24;
+		int sat = 255;
+		pix_t c;
+
+		if (vh > v)
+			v = vh;
+		if (vm > v)
+			v = vm;
+		if (vs > v)
+			v = vs;
+		if (vs > 0)
+			sat -= (vs * 3) >> 2;
+
+		c = (param & 2) ? colour_palette(pal, pos) : colour_hue(pos);
+		fb[i] = colour_sv(c, sat, v);
+	}
+
+	if (param & 1) {
+		d_ticks(fb, 32);
+	}
+}
+
+// Bytecode faces (see facevm.h), indexed by VM_FACE():
+static const uint8_t vm_faces[] = {
+	ASSET_FACE_PIE,
+	ASSET_FACE_PULSE,
+};
+
+void d_vm(pix_t *fb, uint32_t anim, tod_t *time, int param)
+{
+	int32_t env[FV_NUM_FIELDS];
+	int h, m, s;
+	unsigned int id;
+
+	hand_pos(time, &h, &m, &s);
+	env[FV_T_HOUR] = h;
+	env[FV_T_MIN] = m;
+	env[FV_T_SEC] = s;
+	env[FV_T_ANIM] = anim;
+	env[FV_T_PARAM] = param & 0xff;
+
+	id = vm_faces[param >> 8];
+	facevm_run(asset_get(id), asset_size(id), fb, env);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
-static struct dvar {
+// 'shed' gives the param bits that can be dropped when a frame is over
+// budget (2 is sub-pixel smoothing for those that have it).  'trail', if
+// non-zero, leaves a decaying trail behind moving hands (see trail.h; 6 is
+// roughly a quarter-second tail at 300Hz, 7 double that).
+static const struct dvar {
 	dispfunc f;
 	int param;
+	int shed;
+	int trail;
 } disp_variants[] = {
-	{ d_pie,		0 },
-	{ d_pie,		1 },
-	{ d_pie,		2 },
-	{ d_pie,		3 },
-	{ d_simple_soft,       	0 },
-	{ d_simple_soft,       	1 },
-	{ d_simple_soft,	2 },
-	{ d_simple_soft,	3 },
-	{ d_blob_soft,		0 },
-	{ d_blob_soft,		1 },
-	{ d_minimale,		0 },
+	{ d_pie,		0, 0, 0 },
+	{ d_pie,		1, 0, 0 },
+	{ d_pie,		2, 2, 0 },
+	{ d_pie,		3, 2, 0 },
+	{ d_simple_soft,       	0, 0, 0 },
+	{ d_simple_soft,       	1, 0, 0 },
+	{ d_simple_soft,	2, 2, 0 },
+	{ d_simple_soft,	3, 2, 0 },
+	{ d_blob_soft,		0, 0, 0 },
+	{ d_blob_soft,		1, 0, 0 },
+	{ d_minimale,		0, 0, 0 },
+	{ d_arcs,		0, 0, 0 },
+	{ d_arcs,		3, 2, 0 },
+	{ d_arcs,		2, 2, 6 },
+	{ d_simple_soft,	2, 2, 7 },
+	{ d_rainbow,		0, 0, 0 },
+	{ d_rainbow,		3, 0, 0 },
+	{ d_vm,			VM_FACE(0) | 3, 2, 0 },
+	{ d_vm,			VM_FACE(1), 0, 0 },
 };
 
 static const unsigned int disp_len = sizeof(disp_variants) / sizeof(struct dvar);
 
+// Measured render time of each variant in TIM2 cycles (averaged), filled in
+// as faces are used.  Kept out of disp_variants so that can live in flash.
+static uint32_t disp_cost[sizeof(disp_variants) / sizeof(struct dvar)];
+
+////////////////////////////////////////////////////////////////////////////////
+// Frame budget scheduler
+//
+// Render + encode has to fit between two buffer swaps or a swap is missed.
+// Work is tracked against DISP_BUDGET_CYCLES and, when over, the face is
+// degraded step by step:  first smoothing is dropped, then the animation rate
+// is halved/quartered (reusing the previous frame in between).  A lower but
+// regular frame rate looks better than one that judders between hitting and
+// missing the swap.  Steps are undone once there's plenty of headroom again.
+
+enum { DL_NONE, DL_NOSMOOTH, DL_HALFRATE, DL_QUARTERRATE };
+
+#define DL_RELAX_FRAMES	128
+
+static int 		dl_level = DL_NONE;
+static int		dl_relax = 0;
+static unsigned int 	dl_frame = 0;
+static int		dl_drawn = 0;
+static uint32_t 	t_start;
+static uint32_t 	work_avg = 0;	// Render + encode, EWMA over 4 frames
+static disp_stats_t	stats;
+
+static void	sched_reset(void)
+{
+	dl_level = DL_NONE;
+	dl_relax = 0;
+	trail_reset();
+	// Seed with what we know of the new face; 0 if never measured.
+	work_avg = disp_cost[current_disp];
+}
+
+// A frame drawn at half/quarter rate can take two/four refreshes:
+static uint32_t	dl_budget(int level)
+{
+	if (level == DL_QUARTERRATE)
+		return DISP_BUDGET_CYCLES * 4;
+	if (level == DL_HALFRATE)
+		return DISP_BUDGET_CYCLES * 2;
+	return DISP_BUDGET_CYCLES;
+}
+
+// Called after the frame has been handed to the display (render + encode
+// done) to account for it and pick the degradation for the next.
+void	display_frame_done(void)
+{
+	uint32_t work;
+
+	if (!dl_drawn)
+		return;
+	dl_drawn = 0;
+
+	work = time_getfine() - t_start;
+	work_avg = work_avg - (work_avg >> 2) + (work >> 2);
+
+	if (work > dl_budget(dl_level))
+		stats.over_budget++;
+
+	if (work_avg > dl_budget(dl_level)) {
+		if (dl_level < DL_QUARTERRATE) {
+			dl_level++;
+			if (dl_level >= DL_HALFRATE)
+				stats.rate_drops++;
+		}
+		dl_relax = 0;
+	} else if (dl_level != DL_NONE &&
+		   work_avg < dl_budget(dl_level - 1) / 2) {
+		if (++dl_relax == DL_RELAX_FRAMES) {
+			dl_level--;
+			dl_relax = 0;
+		}
+	} else {
+		dl_relax = 0;
+	}
+}
+
+const disp_stats_t *display_get_stats(void)
+{
+	stats.level = dl_level;
+	return &stats;
+}
+
+void	display_debug_stats(void)
+{
+	printf("disp %d: frames %d over %d unsmoothed %d reused %d "
+	       "ratedrops %d level %d cost %d\r\n",
+	       current_disp, stats.frames, stats.over_budget, stats.unsmoothed,
+	       stats.reused, stats.rate_drops, dl_level,
+	       disp_cost[current_disp]);
+}
+
 void	display_init(void)
 {
 #ifdef SIM
@@ -327,23 +576,85 @@ void	display_init(void)
 	if (c)
 		current_disp = atoi(c);
 #else
-	if (RTC_ReadBackupRegister(RTC_BKP_DR0) == 0xdeadbeef) {
-		current_disp = RTC_ReadBackupRegister(RTC_BKP_DR1);
+	if (rtc_warm_boot()) {
+		current_disp = RTC_ReadBackupRegister(RTC_BKP_FACE);
 	}
 #endif
+	if (current_disp >= disp_len)
+		current_disp = 0;
+	sched_reset();
 }
 
-void 	display_draw(pix_t *fb, unsigned int framenum, tod_t *time)
+// Monotonic animation clock in 1/65536s.  It's advanced by the change in
+// time of day, so runs at the RTC's rate (and keeps going while frames are
+// skipped), but doesn't jump when the time is set.  Wraps after ~18h.
+static uint32_t	anim_time(tod_t *time)
 {
-	disp_variants[current_disp].f(fb, framenum, time, disp_variants[current_disp].param);
+	static uint32_t last_tod = 0;
+	static uint32_t anim = 0;
+	uint32_t tod, d;
+
+	tod = ((uint32_t)(((time->hour * 60) + time->min) * 60 + time->sec)
+	       << 16) + time->frac;
+	d = tod - last_tod;
+	if (tod < last_tod)
+		d += (uint32_t)(12*60*60) << 16;	// Passed 12 o'clock
+	if (d > (1 << 16))
+		d = 0;				// Time was set (or first call)
+	last_tod = tod;
+	anim += d;
+	return anim;
+}
+
+int 	display_draw(pix_t *fb, tod_t *time)
+{
+	const struct dvar *d = &disp_variants[current_disp];
+	uint32_t *cost = &disp_cost[current_disp];
+	int param = d->param;
+	uint32_t anim = anim_time(time);
+	uint32_t t_end;
+
+	stats.frames++;
+	dl_frame++;
+
+	// At reduced rates, only every 2nd/4th frame is drawn; the previous
+	// frame stays on display in between.
+	if ((dl_level == DL_HALFRATE && (dl_frame & 1)) ||
+	    (dl_level == DL_QUARTERRATE && (dl_frame & 3))) {
+		stats.reused++;
+		return 0;
+	}
+
+	if (dl_level >= DL_NOSMOOTH && (param & d->shed)) {
+		param &= ~d->shed;
+		stats.unsmoothed++;
+	}
+
+	t_start = time_getfine();
+	d->f(fb, anim, time, param);
+	if (d->trail)
+		trail_apply(fb, d->trail);
+	t_end = time_getfine();
+
+	// Per-face cost (EWMA); only representative when undegraded.
+	if (dl_level == DL_NONE) {
+		if (*cost == 0)
+			*cost = t_end - t_start;
+		else
+			*cost = *cost - (*cost >> 3) + ((t_end - t_start) >> 3);
+	}
+
+	dl_drawn = 1;
+	return 1;
 }
 
 void	display_next(void)
 {
 	if (++current_disp >= disp_len)
 		current_disp = 0;
+	sched_reset();
 #ifndef SIM
-	RTC_WriteBackupRegister(RTC_BKP_DR1, current_disp);
+	RTC_WriteBackupRegister(RTC_BKP_FACE, current_disp);
 #endif
 }
 
@@ -353,8 +664,9 @@ void	display_prev(void)
 		current_disp = disp_len-1;
 	else
 		current_disp--;
+	sched_reset();
 #ifndef SIM
-	RTC_WriteBackupRegister(RTC_BKP_DR1, current_disp);
+	RTC_WriteBackupRegister(RTC_BKP_FACE, current_disp);
 #endif
 }
 
@@ -374,8 +686,8 @@ void 	display_drawspecial(pix_t *fb,
 	int blank = !param_a;
 
 	// Draw on a black background with ticks:
-	for (i = 0; i < 60; i++) {
-		int j = ((i % 5) != 0) || blank ? 0 : 4;
+	for (i = 0; i < RING_PIXELS; i++) {
+		int j = ((i % (5 * RING_MULT)) != 0) || blank ? 0 : 4;
 
 		fb[i].r = j;
 		fb[i].g = j;
@@ -389,7 +701,7 @@ void 	display_drawspecial(pix_t *fb,
 	case DS_HR:
 	case DS_MIN: {
 		// Render an arc, depending on colour:
-		int top = (t == DS_HR) ? param_b * 5 : param_b;
+		int top = ((t == DS_HR) ? param_b * 5 : param_b) * RING_MULT;
 
 		for (i = 0; i <= top; i++) {
 			if (t == DS_HR)
@@ -400,25 +712,25 @@ void 	display_drawspecial(pix_t *fb,
 	} break;
 	case DS_BR_H: {
 		// Starts at top and goes downwards as numbers decrease
-		int nr = (255-param_b)*30/256;
+		int nr = (255-param_b)*(RING_PIXELS/2)/256;
 		for (i = 0; i <= nr; i++) { // Rounds down on divide...
 			fb[i].r = 255;
 			fb[i].g = 128;
 			if (i > 0) {
-				fb[60-i].r = 255;
-				fb[60-i].g = 128;
+				fb[RING_PIXELS-i].r = 255;
+				fb[RING_PIXELS-i].g = 128;
 			}
 		}
 	} break;
 	case DS_BR_L: {
 		// Starts at bottom & goes upwards as numbers increase
-		int nr = param_b*30/256;
+		int nr = param_b*(RING_PIXELS/2)/256;
 		for (i = 0; i <= nr; i++) { // Rounds down on divide...
-			fb[30-i].r = 255;
-			fb[30-i].g = 128;
-			if (i < 30) {
-				fb[30+i].r = 255;
-				fb[30+i].g = 128;
+			fb[RING_PIXELS/2-i].r = 255;
+			fb[RING_PIXELS/2-i].g = 128;
+			if (i < RING_PIXELS/2) {
+				fb[RING_PIXELS/2+i].r = 255;
+				fb[RING_PIXELS/2+i].g = 128;
 			}
 		}
 	} break;
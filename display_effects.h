@@ -19,11 +19,41 @@
 
 #include "rtc.h"
 
+// Render + encode must fit inside one LED refresh (300Hz, matching
+// PWM_REFRESH_HZ), less the ~30% of the CPU that the scan IRQs use.  Measured
+// in TIM2 (48MHz) cycles.
+#define DISP_FRAME_HZ		300
+#define DISP_BUDGET_CYCLES	((48000000 / DISP_FRAME_HZ) * 7 / 10)
+
 void 	display_init(void);
-void 	display_draw(pix_t *fb, unsigned int framenum, tod_t *time);
+// Returns 0 if nothing was drawn (under load, the previous frame should be
+// left on display), otherwise 1.
+int 	display_draw(pix_t *fb, tod_t *time);
+// Call once the drawn frame has been encoded for display:
+void	display_frame_done(void);
 void 	display_next(void);
 void 	display_prev(void);
 
+// Degradation counters from the frame budget scheduler:
+typedef struct {
+	uint32_t	frames;		// display_draw() calls
+	uint32_t	over_budget;	// Drawn frames whose work overran
+	uint32_t	unsmoothed;	// Frames drawn without smoothing
+	uint32_t	reused;		// Frames not drawn (rate lowered)
+	uint32_t	rate_drops;	// Times the animation rate was lowered
+	int		level;		// Current degradation step
+} disp_stats_t;
+
+const disp_stats_t *display_get_stats(void);
+void	display_debug_stats(void);
+
+// Faces, exposed for benchmarking:
+void	d_pie(pix_t *fb, uint32_t anim, tod_t *time, int param);
+void	d_rainbow(pix_t *fb, uint32_t anim, tod_t *time, int param);
+// Bytecode face n (see facevm.h), the low bits passed on as its param:
+void	d_vm(pix_t *fb, uint32_t anim, tod_t *time, int param);
+#define VM_FACE(n)	((n) << 8)
+
 typedef enum { DS_HR, DS_MIN, DS_BR_H, DS_BR_L } DispType;
 
 void 	display_drawspecial(pix_t *fb,
@@ -0,0 +1,165 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * evloop:  Event-driven main loop (see evloop.h).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "evloop.h"
+#include "time.h"
+
+#ifdef SIM
+#include <stdio.h>
+#define irq_off()
+#define irq_on()
+#else
+#include <stm32f0xx.h>
+#include "uart.h"
+#define irq_off()	__disable_irq()
+#define irq_on()	__enable_irq()
+#endif
+
+static volatile uint8_t	pending;
+static ev_handler_t	handlers[EV_NUM];
+static work_t		*defer_head;
+static work_t		*defer_tail;
+static ev_stats_t	stats;
+
+void	ev_handler(int ev, ev_handler_t h)
+{
+	handlers[ev] = h;
+}
+
+void	ev_post(int ev)
+{
+	irq_off();
+	pending |= 1 << ev;
+	irq_on();
+}
+
+void	ev_defer(work_t *w)
+{
+	irq_off();
+	if (!w->queued) {
+		w->queued = 1;
+		w->next = 0;
+		if (defer_tail)
+			defer_tail->next = w;
+		else
+			defer_head = w;
+		defer_tail = w;
+		pending |= 1 << EV_WORK;
+	}
+	irq_on();
+}
+
+// One deferred job per EV_WORK, so that anything more urgent posted
+// meanwhile gets in between:
+static void	ev_work(void)
+{
+	work_t *w;
+
+	irq_off();
+	w = defer_head;
+	if (w) {
+		defer_head = w->next;
+		if (!defer_head)
+			defer_tail = 0;
+		else
+			pending |= 1 << EV_WORK;
+		w->queued = 0;
+	}
+	irq_on();
+	if (w)
+		w->fn(w);
+}
+
+#ifdef SIM
+/* Nothing interrupts on the host:  each pass round the loop is a frame, and
+ * update_display() waits for the host's vsync.  Input's polled from SDL
+ * each frame.
+ */
+static void	ev_sleep(void)
+{
+	pending |= (1 << EV_VSYNC) | (1 << EV_INPUT);
+}
+#else
+static void	ev_sleep(void)
+{
+	uint32_t t = time_getfine();
+
+	// WFI with IRQs masked still wakes for a pending IRQ, so there's no
+	// window for an event to be posted between the check and the sleep:
+	irq_off();
+	if (!pending)
+		__WFI();
+	irq_on();
+	stats.idle_cycles += time_getfine() - t;
+}
+#endif
+
+void	ev_run(void)
+{
+	handlers[EV_WORK] = ev_work;
+
+	while (1) {
+		uint8_t p;
+		int ev;
+		uint32_t t;
+
+		irq_off();
+		p = pending;
+		for (ev = 0; ev < EV_NUM && !(p & (1 << ev)); ev++)
+			;
+		if (ev < EV_NUM)
+			pending = p & ~(1 << ev);
+		irq_on();
+
+		if (ev == EV_NUM) {
+			ev_sleep();
+			continue;
+		}
+		if (!handlers[ev])
+			continue;
+
+		t = time_getfine();
+		handlers[ev]();
+		t = time_getfine() - t;
+
+		stats.runs[ev]++;
+		stats.total_cycles[ev] += t;
+		if (t > stats.max_cycles[ev])
+			stats.max_cycles[ev] = t;
+	}
+}
+
+void	ev_get_stats(ev_stats_t *s, int reset)
+{
+	*s = stats;
+	if (reset)
+		stats = (ev_stats_t){ { 0 } };
+}
+
+void	ev_debug_stats(void)
+{
+	ev_stats_t s;
+	int i;
+
+	ev_get_stats(&s, 1);
+	for (i = 0; i < EV_NUM; i++)
+		printf("ev %d: %d runs, max %d avg %d cycles\r\n", i,
+		       (int)s.runs[i], (int)s.max_cycles[i],
+		       s.runs[i] ? (int)(s.total_cycles[i] / s.runs[i]) : 0);
+	printf("ev idle %d cycles\r\n", (int)s.idle_cycles);
+}
@@ -0,0 +1,60 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <inttypes.h>
+#include "work.h"
+
+/* The main loop:  a run-to-completion scheduler in thread mode.  IRQs (and
+ * PendSV work) post events; the loop runs the handler of the most urgent
+ * pending one, and sleeps when there's nothing to do.  Posting an event
+ * that's already pending does nothing, so a handler sees "at least one
+ * since last time".
+ *
+ * Lower numbers go first:
+ *	EV_VSYNC	The LED buffers have swapped; draw the next frame
+ *	EV_INPUT	Button event(s) ready
+ *	EV_TIMER	Slow periodic jobs (set up with a time_callback_t that
+ *			posts it)
+ *	EV_WORK		Background jobs, run in order from ev_defer()
+ */
+enum { EV_VSYNC, EV_INPUT, EV_TIMER, EV_WORK, EV_NUM };
+
+typedef void (*ev_handler_t)(void);
+
+void	ev_handler(int ev, ev_handler_t h);
+// From anywhere:
+void	ev_post(int ev);
+// Run w->fn(w) from EV_WORK (thread mode, after anything more urgent):
+void	ev_defer(work_t *w);
+// Never returns:
+void	ev_run(void);
+
+// Handler runs and their cost, in TIM2 (48MHz) cycles; idle is the time
+// spent asleep.
+typedef struct {
+	uint32_t	runs[EV_NUM];
+	uint32_t	max_cycles[EV_NUM];
+	uint32_t	total_cycles[EV_NUM];
+	uint32_t	idle_cycles;
+} ev_stats_t;
+
+void	ev_get_stats(ev_stats_t *s, int reset);
+void	ev_debug_stats(void);
+
+#endif
@@ -0,0 +1,225 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * facevm:  Interpreter for bytecode faces (see facevm.h).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "geometry.h"
+#include "facevm.h"
+#include "lookuptables.h"
+
+static inline int clamp8(int32_t v)
+{
+	if (v < 0)
+		return 0;
+	if (v > 255)
+		return 255;
+	return v;
+}
+
+// Pixel index of a ring position.  Positions are almost always in range, so
+// only divide when they aren't.
+static inline int ring_pix(int32_t pos)
+{
+	int p = pos >> 8;
+
+	if ((unsigned int)p >= RING_PIXELS) {
+		p %= RING_PIXELS;
+		if (p < 0)
+			p += RING_PIXELS;
+	}
+	return p;
+}
+
+static inline void set_chans(pix_t *px, int mask, int v)
+{
+	if (mask & 1)
+		px->r = v;
+	if (mask & 2)
+		px->g = v;
+	if (mask & 4)
+		px->b = v;
+}
+
+static inline uint8_t sat_add8(uint8_t a, int b)
+{
+	int i = a + b;
+	return (i > 255) ? 255 : i;
+}
+
+/* Dispatch is threaded:  each handler jumps straight to the next through a
+ * table of label addresses (a GCC extension), rather than going back round a
+ * switch.  Unknown opcodes end the program, as does leaving it.
+ */
+#define A	(pc[1])
+#define B	(pc[2])
+#define C	(pc[3])
+#define RA	r[pc[1] & 15]
+#define RB	r[pc[2] & 15]
+#define RC	r[pc[3] & 15]
+#define IMM	((int16_t)(pc[2] | (pc[3] << 8)))
+#define NEXT	do { if (--steps == 0 || (pc += 4) == end) return;	\
+		     goto *ops[pc[0] & 31]; } while (0)
+
+void	facevm_run(const uint8_t *prog, uint32_t len, pix_t *fb,
+		   const int32_t *env)
+{
+	static const void *const ops[32] = {
+		[FV_END] = &&op_end,
+		[FV_LDI] = &&op_ldi,
+		[FV_TIME] = &&op_time,
+		[FV_ADD] = &&op_add,
+		[FV_SUB] = &&op_sub,
+		[FV_MUL] = &&op_mul,
+		[FV_AND] = &&op_and,
+		[FV_SHR] = &&op_shr,
+		[FV_SHL] = &&op_shl,
+		[FV_SIN] = &&op_sin,
+		[FV_JZ] = &&op_jz,
+		[FV_JNZ] = &&op_jnz,
+		[FV_FILL] = &&op_fill,
+		[FV_RAMP] = &&op_ramp,
+		[FV_SET] = &&op_set,
+		[FV_ADDP] = &&op_addp,
+		[FV_TICKS] = &&op_ticks,
+		// The rest are unknown:
+		&&op_end, &&op_end, &&op_end, &&op_end, &&op_end,
+		&&op_end, &&op_end, &&op_end, &&op_end, &&op_end,
+		&&op_end, &&op_end, &&op_end, &&op_end, &&op_end,
+	};
+	int32_t r[16] = { 0 };
+	const uint8_t *pc = prog;
+	const uint8_t *end = prog + (len & ~3);
+	int steps = FV_MAX_STEPS;
+
+	if (pc == end)
+		return;
+	goto *ops[pc[0] & 31];
+
+op_ldi:
+	RA = IMM;
+	NEXT;
+op_time:
+	RA = (B < FV_NUM_FIELDS) ? env[B] : 0;
+	NEXT;
+op_add:
+	RA = RB + RC;
+	NEXT;
+op_sub:
+	RA = RB - RC;
+	NEXT;
+op_mul:
+	RA = RB * RC;
+	NEXT;
+op_and:
+	RA = RB & RC;
+	NEXT;
+op_shr:
+	RA = RB >> (C & 31);
+	NEXT;
+op_shl:
+	RA = RB << (C & 31);
+	NEXT;
+op_sin:
+	RA = SIN16(RB);
+	NEXT;
+op_jz:
+	if (RA)
+		NEXT;
+	goto jump;
+op_jnz:
+	if (!RA)
+		NEXT;
+jump: {
+		// The target (the instruction after this one, plus imm) must be
+		// in the program too:
+		int32_t off = IMM * 4;
+
+		if (off < prog - pc - 4 || off >= end - pc - 4)
+			return;
+		pc += off;
+	}
+	NEXT;
+
+op_fill: {
+		pix_t c;
+		int i;
+
+		c.r = clamp8(RA);
+		c.g = clamp8(RB);
+		c.b = clamp8(RC);
+		for (i = 0; i < RING_PIXELS; i++)
+			fb[i] = c;
+	}
+	NEXT;
+
+	// The pie hand:  like d_pie(), n pixels fading back from the hand,
+	// the first at 255 less the hand's fraction of a pixel, then a
+	// leading pixel for that fraction.
+op_ramp: {
+		int mask = A & 7;
+		int n = A >> 3;
+		int32_t pos = RB;
+		int32_t step = RC;
+		int st = ring_pix(pos);
+		int fr = pos & 0xff;
+		int br = 255 - ((fr * step) >> 8);
+		int p = st;
+
+		for (; n > 0 && br > 0; n--) {
+			set_chans(&fb[p], mask, clamp8(br));
+			br -= step;
+			if (--p < 0)
+				p = RING_PIXELS-1;
+		}
+		if (fr)
+			set_chans(&fb[(st == RING_PIXELS-1) ? 0 : st + 1], mask, fr);
+	}
+	NEXT;
+
+op_set:
+	set_chans(&fb[ring_pix(RB)], A, clamp8(RC));
+	NEXT;
+
+op_addp: {
+		pix_t *px = &fb[ring_pix(RB)];
+		int v = clamp8(RC);
+
+		if (A & 1)
+			px->r = sat_add8(px->r, v);
+		if (A & 2)
+			px->g = sat_add8(px->g, v);
+		if (A & 4)
+			px->b = sat_add8(px->b, v);
+	}
+	NEXT;
+
+op_ticks: {
+		int i;
+		int br = clamp8(RA);
+
+		for (i = 0; i < RING_PIXELS; i += RING_PIXELS/4) {
+			int j = (i == 0) ? br : br/4;
+			fb[i].r = sat_add8(fb[i].r, j);
+			fb[i].g = sat_add8(fb[i].g, j);
+			fb[i].b = sat_add8(fb[i].b, j);
+		}
+	}
+	NEXT;
+
+op_end:
+	return;
+}
@@ -0,0 +1,80 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FACEVM_H
+#define FACEVM_H
+
+#include "types.h"
+
+/* Bytecode faces:  a face is a small program for a register machine, so new
+ * faces are data rather than code.  Programs are written as faces/NAME.fvs,
+ * assembled by tools/fvasm.py (which also disassembles) and kept in the asset
+ * store.
+ *
+ * Every instruction is 4 bytes:  opcode, then three operand bytes a, b, c.
+ * There are 16 32-bit registers, all 0 at entry.  Positions round the ring
+ * are in 1/256 pixel, as for the native faces (so RING_MULT * 256 per minute
+ * mark); brightnesses are clamped to
+ * 0-255 when drawn.  'imm' is a signed 16-bit b | c << 8; jump offsets are
+ * in instructions, relative to the next.  Channel masks are 1 = R, 2 = G,
+ * 4 = B.
+ *
+ * A program runs once per frame, with no allocation.  Every instruction is
+ * counted and the program stopped after FV_MAX_STEPS, so a bad face can only
+ * waste a frame rather than hang the clock.  Running off either end of the
+ * program (falling off the end, or a jump out of it) stops it as FV_END
+ * does, so it can't wander into the rest of flash either.
+ */
+
+enum {
+	FV_END,		//				stop
+	FV_LDI,		// rd, imm			rd = imm
+	FV_TIME,	// rd, field			rd = env[field]
+	FV_ADD,		// rd, ra, rb			rd = ra + rb
+	FV_SUB,		// rd, ra, rb			rd = ra - rb
+	FV_MUL,		// rd, ra, rb			rd = ra * rb
+	FV_AND,		// rd, ra, rb			rd = ra & rb
+	FV_SHR,		// rd, ra, n			rd = ra >> n (signed)
+	FV_SHL,		// rd, ra, n			rd = ra << n
+	FV_SIN,		// rd, ra			rd = sin(ra/65536 turn) * 32767
+	FV_JZ,		// ra, imm			if (!ra) jump
+	FV_JNZ,		// ra, imm			if (ra) jump
+	FV_FILL,	// rr, rg, rb			every pixel = (rr, rg, rb)
+	FV_RAMP,	// mask | (n << 3), rpos, rstep	n pixels fading by rstep
+					//	back from rpos, plus leading edge
+	FV_SET,		// mask, rpos, rval		pixel at rpos = rval
+	FV_ADDP,	// mask, rpos, rval		pixel at rpos += rval (saturating)
+	FV_TICKS,	// ra				hour markers, brightness ra
+	FV_NUM_OPS
+};
+
+// Fields for FV_TIME:
+enum {
+	FV_T_HOUR,	// Hand positions in 1/256 pixel
+	FV_T_MIN,
+	FV_T_SEC,
+	FV_T_ANIM,	// Animation clock, 1/65536s
+	FV_T_PARAM,	// The variant's param bits
+	FV_NUM_FIELDS
+};
+
+#define FV_MAX_STEPS	1024
+
+// 'len' is the program's size in bytes (asset_size()):
+void	facevm_run(const uint8_t *prog, uint32_t len, pix_t *fb,
+		   const int32_t *env);
+
+#endif
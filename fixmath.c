@@ -0,0 +1,114 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * fixmath:  Division-free fixed-point kernels for effects.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fixmath.h"
+
+// Seeds for 2^32/dn, dn normalised to [2^15, 2^16), indexed by bits 14-9 of
+// dn (i.e. 2^32/((i+64.5) * 512)), less 2^16 so they fit in 16 bits:
+static const uint16_t recip_seed[64] = {
+	64520, 62534, 60608, 58740, 56925, 55163, 53451, 51787,
+	50169, 48595, 47063, 45571, 44119, 42704, 41325, 39981,
+	38670, 37392, 36144, 34926, 33737, 32576, 31442, 30334,
+	29251, 28191, 27156, 26143, 25152, 24182, 23232, 22303,
+	21393, 20501, 19628, 18772, 17933, 17110, 16304, 15513,
+	14738, 13977, 13230, 12498, 11778, 11072, 10379, 9698,
+	9029, 8372, 7727, 7093, 6469, 5856, 5254, 4662,
+	4079, 3506, 2942, 2388, 1842, 1305, 777, 257
+};
+
+uint32_t	fx_recip(uint16_t d)
+{
+	uint32_t dn = d;
+	uint32_t y;
+	int32_t e;
+	int n = 0;
+
+	if (d == 0)
+		return 0xffffffff;
+
+	// No CLZ on v6-M:
+	if (!(dn & 0xff00)) { dn <<= 8; n += 8; }
+	if (!(dn & 0xf000)) { dn <<= 4; n += 4; }
+	if (!(dn & 0xc000)) { dn <<= 2; n += 2; }
+	if (!(dn & 0x8000)) { dn <<= 1; n += 1; }
+
+	y = recip_seed[(dn >> 9) & 0x3f] + 0x10000;
+
+	// One Newton-Raphson step, y' = y(2 - dn.y), in 32 bits:  dn.y is
+	// ~2^32, so the wrapped product is (minus) the error.
+	e = (int32_t)(0 - dn * y);
+	y += ((int32_t)(y >> 1) * (e >> 15)) >> 16;
+
+	// y ~= 2^32/dn = 2^(32-n)/d; want 2^24/d:
+	return (n >= 8) ? (y << (n - 8)) : (y >> (8 - n));
+}
+
+// 65535 * 2^(-i/32):
+static const uint16_t exp2_frac[33] = {
+	65535, 64131, 62757, 61412, 60096, 58808, 57548, 56315,
+	55108, 53927, 52772, 51641, 50534, 49452, 48392, 47355,
+	46340, 45347, 44376, 43425, 42494, 41584, 40693, 39821,
+	38967, 38132, 37315, 36516, 35733, 34968, 34218, 33485,
+	32768
+};
+
+uint16_t	fx_decay(uint32_t x)
+{
+	uint32_t k = x >> 8;
+	int f = x & 0xff;
+	int i = f >> 3;
+	uint32_t v;
+
+	if (k >= 16)
+		return 0;
+	v = exp2_frac[i];
+	v -= ((v - exp2_frac[i+1]) * (f & 7)) >> 3;
+	return v >> k;
+}
+
+uint16_t	fx_isqrt(uint32_t x)
+{
+	uint32_t res = 0;
+	uint32_t bit = 1UL << 30;
+
+	while (bit > x)
+		bit >>= 2;
+	while (bit) {
+		if (x >= res + bit) {
+			x -= res + bit;
+			res = (res >> 1) + bit;
+		} else {
+			res >>= 1;
+		}
+		bit >>= 2;
+	}
+	return res;
+}
+
+uint32_t	fx_smoothstep(int32_t x)
+{
+	uint32_t x2;
+
+	if (x <= 0)
+		return 0;
+	if (x >= 65536)
+		return 65536;
+	x2 = ((uint32_t)x * x) >> 16;
+	// x2 * (3 - 2x), with (3 - 2x) taken down 2 bits to stay in 32:
+	return (x2 * ((3*65536 - 2*(uint32_t)x) >> 2)) >> 14;
+}
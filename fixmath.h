@@ -0,0 +1,40 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+#include <inttypes.h>
+
+/* Fixed-point helpers for effects.  The M0 has a single-cycle multiply but
+ * no divide (or CLZ), so none of these divide.
+ */
+
+// ~2^24/d, to ~14 bits; x/d is then (x * fx_recip(d)) >> 24 for small x.
+// d = 0 gives 0xffffffff.
+uint32_t	fx_recip(uint16_t d);
+
+// 2^-x, x in 1/256 (Q8), result Q16 (65535 ~= 1.0).  exp(-t/tau) is
+// fx_decay(t * 369 / tau) (369 ~= 256/ln2).
+uint16_t	fx_decay(uint32_t x);
+
+// floor(sqrt(x))
+uint16_t	fx_isqrt(uint32_t x);
+
+// 3x^2 - 2x^3 in Q16; x outside 0-65536 is clamped.
+uint32_t	fx_smoothstep(int32_t x);
+
+#endif
@@ -0,0 +1,44 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+/* Ring geometry.  The LEDs are scanned in thirds (one common FET each); in
+ * each third every 16-bit sink driver lights a group of 5 RGB LEDs.  The
+ * original PCB has a driver per quadrant, so 4 * 3 * 5 = 60 pixels.
+ *
+ * Everything sized by pixel count (faces, the sim, the PWM encoder) comes
+ * from here.  Build with e.g. 'make RING_DRIVERS=8' for a 120-pixel ring.
+ * Faces are drawn in terms of the 60 minute marks, so the pixel count has
+ * to be a multiple of 60.
+ */
+
+#ifndef RING_DRIVERS
+#define RING_DRIVERS	4	// Chained 16-bit drivers
+#endif
+#define RING_THIRDS	3	// Fixed by the three common FETs (B_SA-B_SC)
+#define RING_GROUP	5	// RGB LEDs per driver per third
+
+#define RING_PIXELS	(RING_DRIVERS * RING_THIRDS * RING_GROUP)
+// Pixels per minute mark:
+#define RING_MULT	(RING_PIXELS / 60)
+
+#if (RING_PIXELS % 60) != 0
+#error "RING_DRIVERS must give a multiple of 60 pixels"
+#endif
+
+#endif
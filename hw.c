@@ -20,8 +20,11 @@
 #include <stm32f0xx.h>
 /* Yuck, I am using the STM libs after all.  Just this one... */
 #include <stm32f0xx_rcc.h>
+#include <stm32f0xx_rtc.h>
 
 #include "hw.h"
+#include "rtc.h"
+#include "boot.h"
 #include "time.h"
 #include "spi.h"
 #include "uart.h"
@@ -50,6 +53,13 @@ static void	setup_hse_clock(void)
 	 */
 	/* Enable Prefetch Buffer and set Flash Latency */
 	FLASH->ACR = FLASH_ACR_PRFTBE | FLASH_ACR_LATENCY;
+	/* A warm boot starts from the trim the LSE calibration settled on: */
+	if (rtc_warm_boot()) {
+		uint32_t t = RTC_ReadBackupRegister(RTC_BKP_HSITRIM);
+
+		if (t & RTC_BKP_VALID)
+			RCC->CR = (RCC->CR & ~RCC_CR_HSITRIM) | ((t & 0x1f) << 3);
+	}
 	/* HCLK = SYSCLK */
 	RCC->CFGR |= (uint32_t)RCC_CFGR_HPRE_DIV1;
 	/* PCLK = HCLK */
@@ -74,6 +84,44 @@ static void	setup_hse_clock(void)
 	       (uint32_t)RCC_CFGR_SWS_PLL) { }
 }
 
+static struct {
+	int32_t		ppm, min_ppm, max_ppm;
+	uint16_t	trims;
+} hsi_stats;
+
+// err is TIM2 cycles gained (HSI fast) or lost over HSI_CAL_SECS, from PendSV.
+void	hw_hsi_trim(int32_t err)
+{
+	// ppm = err / (HSI_CAL_SECS * cycles per us), near enough:
+	int32_t ppm = ((int64_t)err *
+		       ((1 << 20) / (HSI_CAL_SECS * (SYS_CLK / 1000000)))) >> 20;
+	uint32_t cr = RCC->CR;
+	int trim = (cr & RCC_CR_HSITRIM) >> 3;
+
+	hsi_stats.ppm = ppm;
+	if (ppm < hsi_stats.min_ppm)
+		hsi_stats.min_ppm = ppm;
+	if (ppm > hsi_stats.max_ppm)
+		hsi_stats.max_ppm = ppm;
+
+	if (ppm > HSI_TRIM_HYST_PPM && trim > 0)
+		trim--;
+	else if (ppm < -HSI_TRIM_HYST_PPM && trim < 31)
+		trim++;
+	else
+		return;
+	RCC->CR = (cr & ~RCC_CR_HSITRIM) | (trim << 3);
+	RTC_WriteBackupRegister(RTC_BKP_HSITRIM, trim | RTC_BKP_VALID);
+	hsi_stats.trims++;
+}
+
+void	hw_hsi_debug(void)
+{
+	printf("hsi: trim %d, %d ppm (%d to %d), %d trims\r\n",
+	       (int)((RCC->CR & RCC_CR_HSITRIM) >> 3), (int)hsi_stats.ppm,
+	       (int)hsi_stats.min_ppm, (int)hsi_stats.max_ppm,
+	       hsi_stats.trims);
+}
 
 void	hw_init(void)
 {
@@ -81,17 +129,22 @@ void	hw_init(void)
 	RCC_GetClocksFreq(&RCC_Clocks);
 	// Or use SystemCoreClock/48000
 	setup_hse_clock();
+	// TIM2 first, so the rest can be timed:
+	time_init();
+	boot_mark("clock");
 
 	/* Urgh!  Remember to switch on everything we touch... */
 	RCC->AHBENR |= RCC_AHBENR_GPIOAEN;
 	RCC->AHBENR |= RCC_AHBENR_GPIOBEN;
 
 	flashvars_init();
+	boot_mark("flashvars");
         io_init();
 	uart_init();
-	time_init();
 	spi_init();
+	boot_mark("io");
 	lightsense_init();
+	boot_mark("lightsense");
 	input_init();
 
 	printf("Hello das world!\n");
@@ -44,4 +44,17 @@ void	hw_init(void);
 
 #define SYS_CLK 48000000
 
+/* The PLL runs from the HSI, which is only good to 1% or so and wanders with
+ * temperature; that shifts the scan refresh, the timers and the UART.  The
+ * RTC alarm (LSE) counts TIM2 cycles over HSI_CAL_SECS seconds and
+ * hw_hsi_trim() nudges HSITRIM (about 0.5% a step) when it's out by more
+ * than HSI_TRIM_HYST_PPM.  That's a bit over half a step, so it doesn't
+ * dither between two steps either side of 48MHz.
+ */
+#define HSI_CAL_SECS		8
+#define HSI_TRIM_HYST_PPM	3000
+
+void	hw_hsi_trim(int32_t err);
+void	hw_hsi_debug(void);
+
 #endif
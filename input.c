@@ -19,19 +19,18 @@
 #include <inttypes.h>
 #include "input.h"
 
+#include "time.h"
+
 #ifdef SIM
 #include "sim_disp.h"
 #else
 #include <stm32f0xx.h>
 #include "hw.h"
-#include "time.h"
+#include "evloop.h"
+#include "work.h"
+#include "uart.h"	// for printf
 #endif
 
-// Debounce/hold thresholds:
-#define DB_THRESH	5
-#define DB_HOLD_TIME	100	// 1 second
-
-
 // Simple debounced buttons:
 uint8_t	input_get_raw(void)
 {
@@ -43,42 +42,108 @@ uint8_t	input_get_raw(void)
 #endif
 }
 
-static	uint8_t 	ev_gen = 0;
-static	InputEvent	event = IE_NONE;
+/* Events go through a ring, written by the button sampling (PendSV) and
+ * read by the main loop.  With one writer and one reader it needs no lock:
+ * only the writer moves head, only the reader moves tail, and each entry's
+ * written before head passes it.  If it's full, the new event's dropped and
+ * counted.
+ */
+#define INPUT_RING	8	// Power of 2
+
+// Keeps the compiler from moving the entry past the index update (one
+// core, so that's all that's needed):
+#define barrier()	__asm__ volatile("" ::: "memory")
 
-InputEvent	input_get_event(void)
+static	input_rec_t		ring[INPUT_RING];
+static	volatile uint8_t	ring_head, ring_tail;
+static	uint32_t		ring_overflows;
+
+static void	input_push(InputEvent e, uint32_t t)
+{
+	uint8_t h = ring_head;
+
+	if ((uint8_t)(h - ring_tail) >= INPUT_RING) {
+		ring_overflows++;
+		return;
+	}
+	ring[h & (INPUT_RING-1)].event = e;
+	ring[h & (INPUT_RING-1)].t = t;
+	barrier();
+	ring_head = h + 1;
+#ifndef SIM
+	ev_post(EV_INPUT);
+#endif
+}
+
+int	input_get(input_rec_t *r)
 {
-	InputEvent e = IE_NONE;
-	// Events are one-shot; once consumed, return IE_NONE.
+	uint8_t t = ring_tail;
 
 #ifdef SIM
 	int i = sim_disp_event();
 	switch (i & 7) {
 	case 1:
-		event = (i & 0x80) ? IE_BHOLD : IE_BUP;
+		input_push((i & 0x80) ? IE_BHOLD : IE_BUP, time_getfine());
 		break;
 	case 2:
-		event = (i & 0x80) ? IE_LHOLD : IE_LUP;
+		input_push((i & 0x80) ? IE_LHOLD : IE_LUP, time_getfine());
 		break;
 	case 4:
-		event = (i & 0x80) ? IE_RHOLD : IE_RUP;
+		input_push((i & 0x80) ? IE_RHOLD : IE_RUP, time_getfine());
 		break;
 	}
 #endif
-	// BTW: This is racy and not good pracice; one ought to save IRQ mask &
-	// then disable IRQs across this.  But, it really doesn't matter much
-	// given it's a missed button press and this isn't firmware for a
-	// life-support device.  In fact, this comment is longer than writing
-	// the correct code, but hey-ho.
-	e = event;
-	event = IE_NONE;
-	return e;
+	if (t == ring_head)
+		return 0;
+	barrier();
+	*r = ring[t & (INPUT_RING-1)];
+	barrier();
+	ring_tail = t + 1;
+	return 1;
+}
+
+InputEvent	input_get_event(void)
+{
+	input_rec_t r;
+
+	// Events are one-shot; once consumed, they're gone.
+	return input_get(&r) ? r.event : IE_NONE;
+}
+
+uint32_t	input_get_overflows(void)
+{
+	return ring_overflows;
 }
 
 #ifndef SIM
+/* The buttons interrupt on either edge (EXTI), which stamps the edge with
+ * TIM2 and starts sampling every DB_SAMPLE_MS.  All three are debounced at
+ * once with a vertical counter:  a 2-bit counter per button, held as two
+ * bitmasks, that must see DB_SAMPLES samples in a row differing from the
+ * debounced state before the state flips.  Once nothing's pressed or
+ * bouncing, the sampling stops until the next edge.
+ */
+#define BUTTONS		0xb	// PA0, PA1, PA3
+#define DB_SAMPLE_MS	2
+#define DB_SAMPLES	4	// (Fixed by the 2-bit counter)
+#define DB_HOLD_TIME	(1000 / DB_SAMPLE_MS)	// 1 second
+
 static time_callback_t tcb;
+static volatile uint8_t	polling;
+
+static uint8_t	db_state;		// Debounced, 1 = pressed
+static uint8_t	db_ct0 = 0xff, db_ct1 = 0xff;
+static int	dtime_button[3] = {0};	// Samples held down
+
+// TIM2 at the first edge of each button's change (by GPIO bit), for the
+// button to event latency:
+static volatile uint32_t t_edge[4];
+static volatile uint8_t	edge_armed;
 
-static int	dtime_button[3] = {0};
+static struct {
+	uint32_t	last, max;	// cycles
+	uint32_t	events;
+} latency;
 
 static const int button_bits[] = { 0, 1, 3 };
 static const InputEvent button_devts[] = { IE_BDOWN, IE_LDOWN, IE_RDOWN };
@@ -86,30 +151,128 @@ static const InputEvent button_uevts[] = { IE_BUP, IE_LUP, IE_RUP };
 static const InputEvent button_hevts[] = { IE_BHOLD, IE_LHOLD, IE_RHOLD };
 static const InputEvent button_huevts[] = { IE_BHOLDUP, IE_LHOLDUP, IE_RHOLDUP };
 
+// When the change started:  the first edge if there was one, else now.
+static uint32_t	button_latency(int bit, uint32_t now)
+{
+	if (edge_armed & (1 << bit)) {
+		latency.last = now - t_edge[bit];
+		if (latency.last > latency.max)
+			latency.max = latency.last;
+		latency.events++;
+		return t_edge[bit];
+	}
+	return now;
+}
+
 static void 	button_samp_tcb(uint64_t t_now)
 {
-	int i;
-
-	for (i = 0; i < 3; i++) {
-		if (!(GPIOA->IDR & (1 << button_bits[i]))) {
-			// Pushed
-			int t = ++dtime_button[i];
-			if (t == DB_HOLD_TIME) {
-				event = button_hevts[i];
-			} else if (t == DB_THRESH) {
-				event = button_devts[i];
-			}
-		} else {
-			// Unpushed
-			int t = dtime_button[i];
-			if (t > DB_HOLD_TIME) {
-				event = button_huevts[i];
-			} else if (t > DB_THRESH) {
-				event = button_uevts[i];
+	uint32_t now = time_getfine();
+	uint8_t raw = input_get_raw();
+	uint8_t i, stop;
+
+	// Count up the buttons that differ; reset the rest:
+	i = db_state ^ raw;
+	db_ct0 = ~(db_ct0 & i);
+	db_ct1 = db_ct0 ^ (db_ct1 & i);
+	i &= db_ct0 & db_ct1;		// Rolled over:  flip these
+	db_state ^= i;
+
+	for (int b = 0; b < 3; b++) {
+		uint8_t m = 1 << button_bits[b];
+
+		if (i & m) {
+			uint32_t t = button_latency(button_bits[b], now);
+
+			if (db_state & m) {
+				dtime_button[b] = 0;
+				input_push(button_devts[b], t);
+			} else if (dtime_button[b] >= DB_HOLD_TIME) {
+				input_push(button_huevts[b], t);
+			} else {
+				input_push(button_uevts[b], t);
 			}
-			dtime_button[i] = 0;
+		} else if ((db_state & m) &&
+			   ++dtime_button[b] == DB_HOLD_TIME) {
+			input_push(button_hevts[b], now);
+		}
+	}
+
+	__disable_irq();
+	// Stamps for bounces that came to nothing go:
+	edge_armed &= db_state ^ raw;
+	raw = input_get_raw();
+	stop = !db_state && !(db_state ^ raw);
+	if (stop)
+		polling = 0;
+	__enable_irq();
+	if (!stop)
+		time_callback_once(&tcb, DB_SAMPLE_MS);
+}
+
+static void	button_edge(void)
+{
+	uint32_t now = time_getfine();
+	uint32_t pr = EXTI->PR & BUTTONS;
+
+	EXTI->PR = pr;
+	for (int b = 0; b < 4; b++) {
+		if ((pr & (1 << b)) && !(edge_armed & (1 << b))) {
+			t_edge[b] = now;
+			edge_armed |= 1 << b;
 		}
 	}
+	if (!polling) {
+		polling = 1;
+		time_callback_once(&tcb, DB_SAMPLE_MS);
+	}
+}
+
+void	EXTI0_1_IRQHandler(void)
+{
+	button_edge();
+}
+
+void	EXTI2_3_IRQHandler(void)
+{
+	button_edge();
+}
+
+/* Button to photon:  from an event's stamp to the refresh that showed what
+ * it did, binned in powers of two of milliseconds (<2, <4 ... <128, more).
+ */
+#define PHOTON_BINS	8
+
+static struct {
+	uint32_t	last, max;	// us
+	uint32_t	bins[PHOTON_BINS];
+} photon;
+
+void	input_photon(uint32_t cycles)
+{
+	uint32_t us = cycles / (SYS_CLK / 1000000);
+	int b = 0;
+
+	photon.last = us;
+	if (us > photon.max)
+		photon.max = us;
+	for (us >>= 11; us && b < PHOTON_BINS-1; us >>= 1)
+		b++;
+	photon.bins[b]++;
+}
+
+void	input_debug(void)
+{
+	printf("input: %d events, latency %dus (max %dus), %d dropped\r\n",
+	       (int)latency.events, (int)(latency.last / (SYS_CLK / 1000000)),
+	       (int)(latency.max / (SYS_CLK / 1000000)),
+	       (int)ring_overflows);
+	printf("photon: %dus (max %dus); ms", (int)photon.last,
+	       (int)photon.max);
+	for (int b = 0; b < PHOTON_BINS; b++)
+		printf(" %s%d:%d", (b < PHOTON_BINS-1) ? "<" : ">=",
+		       2 << (b < PHOTON_BINS-1 ? b : b-1),
+		       (int)photon.bins[b]);
+	printf("\r\n");
 }
 
 void	input_init(void)
@@ -126,8 +289,24 @@ void	input_init(void)
 	GPIOA->PUPDR |= 0x45;	// Pull-up
 
 	tcb.callback = button_samp_tcb;
-	tcb.period = 10; 	/* ms */
-        time_callback_periodic(&tcb);
+
+	// EXTI lines 0, 1 and 3 from port A, both edges:
+	RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+	SYSCFG->EXTICR[0] &= ~0xf0ff;
+	EXTI->RTSR |= BUTTONS;
+	EXTI->FTSR |= BUTTONS;
+	EXTI->PR = BUTTONS;
+	EXTI->IMR |= BUTTONS;
+	NVIC_SetPriority(EXTI0_1_IRQn, IRQ_PRIO_TICK);
+	NVIC_SetPriority(EXTI2_3_IRQn, IRQ_PRIO_TICK);
+	NVIC_EnableIRQ(EXTI0_1_IRQn);
+	NVIC_EnableIRQ(EXTI2_3_IRQn);
+
+	// Held since boot (no edge to start things):
+	if (input_get_raw()) {
+		polling = 1;
+		time_callback_once(&tcb, DB_SAMPLE_MS);
+	}
 }
 #else
 void	input_init(void)
@@ -17,6 +17,8 @@
 #ifndef INPUT_H
 #define INPUT_H
 
+#include <inttypes.h>
+
 /* Input/UI system:
  * Follow basic 'click' events of buttons, but also
  * track 'holds' and long presses.
@@ -42,7 +44,21 @@ typedef enum { IE_NONE,
 	       IE_BHOLDUP,
 } InputEvent;
 
-// Event consumption:
+typedef struct {
+	InputEvent	event;
+	uint32_t	t;	// TIM2 at the first edge (or the hold)
+} input_rec_t;
+
+// Event consumption, oldest first.  input_get() returns 0 when there are
+// none; input_get_event() gives IE_NONE.
+int		input_get(input_rec_t *r);
 InputEvent	input_get_event(void);
+// Events dropped because the queue was full:
+uint32_t	input_get_overflows(void);
+
+// Button edge to event latency, now and then:
+void	input_debug(void);
+// Record an event's stamp to LEDs latency, in TIM2 cycles:
+void	input_photon(uint32_t cycles);
 
 #endif
@@ -22,11 +22,15 @@
 #include <stm32f0xx_tim.h>
 
 #include "types.h"
+#include "geometry.h"
 #include "hw.h"
+#include "led_timing.h"
+#include "ledmap.h"
 #include "led_disp.h"
 #include "time.h"
 #include "spi.h"
 #include "lightsense.h"
+#include "evloop.h"
 
 // Internal IRQ handler state:
 static int scan_third = 0;
@@ -36,22 +40,17 @@ static int cur_step = 0;
 static volatile int dma_irqs = 0;
 static volatile int timer_irqs = 0;
 static volatile unsigned int userspins = 0;
+static volatile unsigned int refreshes = 0;
 
-// At the end, N 'ticks' are all black, to give time for pullups to
-// settle/discharge/etc. (Observed significant 'bleed' from one run through to
-// the next on a different common pullup, first FET was not switching off fully
-// before second FET was switched on.)
-#define PWM_DEAD_TIME 	1
-
-#define PWM_SHIFT 	6
-#define PWM_STEPS 	(1<<PWM_SHIFT)
-#define PWM_REFRESH_HZ 	300
-#define PWM_TIMER_HZ 	(PWM_REFRESH_HZ * 3 * (PWM_STEPS + PWM_DEAD_TIME))
+// PWM depth, dead time and the refresh rate for this chain length are in
+// led_timing.h.
 
 // This buffer holds 'flattened' bitstream data that's sent to the driver shift
 // regs via SPI ever 'PWM tick'.  When the framebuffer is updated, this buffer
 // is recalculated, rather than doing the maths every interrupt.
-static uint16_t pwm_data[2][3][4 * (PWM_STEPS + PWM_DEAD_TIME)];
+// (It grows with RING_DRIVERS; past the 60-pixel ring it no longer fits
+// the F051's 4K, so bigger rings need a bigger part.)
+static uint16_t pwm_data[2][RING_THIRDS][LED_BURST_WORDS * (PWM_STEPS + PWM_DEAD_TIME)];
 // Common sizes:  6-bit PWM/64 levels ~= 1.5KB
 // Common sizes:  7-bit PWM/128 levels ~= 3KB
 
@@ -61,6 +60,11 @@ static uint16_t pwm_data[2][3][4 * (PWM_STEPS + PWM_DEAD_TIME)];
 static int 		buf_wr = 0;
 static volatile int 	buf_rd = 1;
 
+// Frames submitted, and shown (with TIM2 when the last went up):
+static uint32_t			submit_seq;
+static volatile uint32_t	shown_seq;
+static volatile uint32_t	shown_t;
+
 static inline int led_buffer_new(void)
 {
 	return buf_wr == buf_rd;
@@ -71,20 +75,52 @@ static void led_buffer_swap(void)
 	// If a new buffer is pending, swap ptr & use new one
 	if (led_buffer_new()) {
 		buf_rd = 1 ^ buf_rd;
+		shown_seq++;
+		shown_t = time_getfine();
 	}
 }
 
-void led_fb_vsync_swap(void)
+uint32_t led_fb_submit(void)
 {
 	// 2 ptrs; displaying & writing.
 	// write fb_data into off-screen buffer[writing]
 	// then update writing = displaying.
-	// Then, we wait for them to become non-equal, in wfi().
-	// IRQ sees they're equal and 'flips', so displaying = !displaying
-	// Then, we're done.
+	// IRQ sees they're equal and 'flips', so displaying = !displaying,
+	// and posts EV_VSYNC.  Until then, the buffer mustn't be written.
 
 	buf_wr = 1 ^ buf_wr;
-	while (led_buffer_new()) { __WFI(); }
+	return ++submit_seq;
+}
+
+int led_fb_ready(void)
+{
+	return !led_buffer_new();
+}
+
+int led_fb_reclaim(void)
+{
+	int r;
+
+	// Before the scan IRQ can swap it in:
+	__disable_irq();
+	r = led_buffer_new();
+	if (r) {
+		buf_wr = 1 ^ buf_wr;
+		submit_seq--;
+	}
+	__enable_irq();
+	return r;
+}
+
+uint32_t led_fb_shown(uint32_t *t)
+{
+	uint32_t seq;
+
+	__disable_irq();
+	seq = shown_seq;
+	*t = shown_t;
+	__enable_irq();
+	return seq;
 }
 
 static inline void a_io(int bit, int on)
@@ -98,71 +134,40 @@ static inline void b_io(int bit, int on)
 }
 
 
-// LED position (0-4 in group of 5) to driver bit map, for R/G/B colours:
-static const unsigned char led_rgb_to_bit[3][5] = {
-	/* R */
-	{ 12, 10, 6, 3, 0 },
-	/* G */
-	{ 13, 9,  7, 4, 1 },
-	/* B */
-	{ 14, 8, 11, 5, 2 }
-};
-
-// Framebuffers generally run from 12o'clock CW; when hung, the clock's quadrant
-// 2 (third) is at the top and the 12o'clock pixel (pixel 0) is LED 36.  Convert
-// an index from one to the other:
-static int rotate_offset(int o)
-{
-	o -= 7 + 30;
-	if (o < 0)
-		o += 60;
-	return o;
-}
-
-void	led_fb_to_pwm_buffer(pix_t *fb, int offset_to_12oclock)
+void	led_fb_to_pwm_buffer(pix_t *fb)
 {
 	/* Transform RGB values in 'framebuffer' into data that can be directly
 	 * (and quickly) clocked out to the drivers.
+	 *
+	 * Each pixel's third, word and driver bits come straight from the
+	 * generated led_map (ledmap.h), and an LED's bit is set in the first
+	 * 'brightness' steps, so the work goes with how much is lit rather
+	 * than comparing every LED at every step.  The dead-time words at the
+	 * end of each third stay zero, a dark gap so that the common/FET
+	 * pullups can be altered without messing with /OE.
 	 */
-	for (int third = 0; third < 3; third++) {
-		int po = 0;
-		for (int ps = 0; ps < PWM_STEPS; ps++) {
-			uint16_t *w = &pwm_data[buf_wr][third][po];
-
-			for (int quadrant = 0; quadrant < 4; quadrant++) {
-				w[quadrant] = 0;
-				for (int i = 0; i < 5; i++) {
-					// quadrant 0 is actually the most CW
-					// one, quadrant 3 being the 'start'
-					// (MCU)
-					int pix_in_quad = ((3-quadrant)*15)+i;
-					int pix_idx = pix_in_quad + (third * 5);
-
-					if (offset_to_12oclock)
-						pix_idx = rotate_offset(pix_idx);
-
-					// The words are shifted out MSB first, so
-					// Driver bit 15 means bit shifted out first
-					if ((fb[pix_idx].r>>(8-PWM_SHIFT)) > ps) {
-						w[quadrant] |= 1 << led_rgb_to_bit[0][i];
-					}
-					if ((fb[pix_idx].g>>(8-PWM_SHIFT)) > ps) {
-						w[quadrant] |= 1 << led_rgb_to_bit[1][i];
-					}
-					if ((fb[pix_idx].b>>(8-PWM_SHIFT)) > ps) {
-						w[quadrant] |= 1 << led_rgb_to_bit[2][i];
-					}
-				}
+	uint16_t *buf = &pwm_data[buf_wr][0][0];
+
+	for (int i = 0; i < RING_THIRDS*LED_BURST_WORDS*(PWM_STEPS+PWM_DEAD_TIME); i++)
+		buf[i] = 0;
+
+	for (int p = 0; p < RING_PIXELS; p++) {
+		const led_map_t *m = &led_map[p];
+		uint16_t *w = &pwm_data[buf_wr][m->third][m->word];
+		uint8_t v[3] = { fb[p].r >> (8-PWM_SHIFT),
+				 fb[p].g >> (8-PWM_SHIFT),
+				 fb[p].b >> (8-PWM_SHIFT) };
+
+		// The words are shifted out MSB first, so driver bit 15
+		// means bit shifted out first
+		for (int c = 0; c < 3; c++) {
+			uint16_t mask = m->mask[c];
+			uint16_t *s = w;
+
+			for (int ps = 0; ps < v[c]; ps++) {
+				*s |= mask;
+				s += LED_BURST_WORDS;
 			}
-			po += 4;
-		}
-		for (int i = 0; i < PWM_DEAD_TIME; i++) {
-			// The final burst output is a dark gap so that the
-			// common/FET pullups can be altered without messing with /OE:
-			pwm_data[buf_wr][third][po++] = 0;
-			pwm_data[buf_wr][third][po++] = 0;
-			pwm_data[buf_wr][third][po++] = 0;
-			pwm_data[buf_wr][third][po++] = 0;
 		}
 	}
 }
@@ -260,8 +265,8 @@ void	led_disp_init(void)
 
 	/* Zero PWM data buffer */
 	for (int b = 0; b < 2; b++) {
-		for (int t = 0; t < 3; t++) {
-			for (int i = 0; i < PWM_STEPS+PWM_DEAD_TIME; i++) {
+		for (int t = 0; t < RING_THIRDS; t++) {
+			for (int i = 0; i < LED_BURST_WORDS*(PWM_STEPS+PWM_DEAD_TIME); i++) {
 				pwm_data[b][t][i] = 0;
 			}
 		}
@@ -284,7 +289,7 @@ void	led_disp_init(void)
 	cur_step = 0;
 
 	NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
-        NVIC_SetPriority(DMA1_Channel2_3_IRQn, 0);
+        NVIC_SetPriority(DMA1_Channel2_3_IRQn, IRQ_PRIO_SCAN);
 
 	//////////////////////////////////////////////////////////////////////
 	// Set up Timer14:
@@ -296,7 +301,7 @@ void	led_disp_init(void)
 
 	// Periph clock is 48MHz
 	TIM14->PSC = 1; 	// /2, so 24MHz timer clock
-	TIM14->ARR = 24000000/PWM_TIMER_HZ;
+	TIM14->ARR = PWM_TIMER_CLK/PWM_TIMER_HZ;
 	TIM14->CNT = 0;
 
 	TIM14->CR1 = TIM_CR1_URS | // Only ovf makes irq
@@ -304,7 +309,7 @@ void	led_disp_init(void)
 		TIM_CR1_CEN;
 
 	NVIC_EnableIRQ(TIM14_IRQn);
-        NVIC_SetPriority(TIM14_IRQn, 0);
+        NVIC_SetPriority(TIM14_IRQn, IRQ_PRIO_SCAN);
 
 	// Timer now running, triggering DMA to SPI for sink driver shift
 	// registers.
@@ -346,9 +351,11 @@ void TIM14_IRQHandler(void)
 	if (cur_step == (PWM_STEPS+PWM_DEAD_TIME)) {
 		cur_step = 0;
 		// Wrapped, move to next third:
-		if (++scan_third == 3) {
+		if (++scan_third == RING_THIRDS) {
 			led_buffer_swap();
 			scan_third = 0;
+			refreshes++;
+			ev_post(EV_VSYNC);
 		}
 
 		cur_arr_idx = 0;
@@ -361,15 +368,15 @@ void TIM14_IRQHandler(void)
 		// next third:
 		GPIOB->BSRR = (1 << (B_SA + scan_third));	// On
 	} else {
-		/* Arrange for 4 halfwords to be DMAd
-		 * to SPI:
+		/* Arrange for a halfword per driver to be DMAd
+		 * to SPI (led_timing.h checks the burst fits the tick):
 		 */
 		DMA1_Channel3->CCR &= ~DMA_CCR_EN;
 		// This data will be all zeros when cur_step >= PWM_STEPS (i.e.
 		// dead-time cycle)
 		DMA1_Channel3->CMAR = (uintptr_t)&pwm_data[buf_rd][scan_third][cur_arr_idx];
-		DMA1_Channel3->CNDTR = 4;	// Num de halfwords
-		cur_arr_idx += 4;
+		DMA1_Channel3->CNDTR = LED_BURST_WORDS;	// Num de halfwords
+		cur_arr_idx += LED_BURST_WORDS;
 		cur_step++;
 
 		// Seems to need to be set separately:
@@ -382,10 +389,10 @@ void TIM14_IRQHandler(void)
 
 void led_test(void)
 {
-	pix_t fb[60];
+	pix_t fb[RING_PIXELS];
 
 	// Set up a test pattern:
-	for (int b = 0; b < 60; b++) {
+	for (int b = 0; b < RING_PIXELS; b++) {
 //#define SIMPLE
 #ifdef SIMPLE	// Basic test
 		fb[b].r = 0;//b*2;
@@ -393,7 +400,8 @@ void led_test(void)
 		fb[b].b = 0;//b*4;
 
 		// This test pattern is useful for seeing inter-third 'bleed'
-		// where the common pullups allow ghosting between scans:
+		// where the common pullups allow ghosting between scans.
+		// (Positions are clock positions, through led_map.)
 		fb[0].r = 256/PWM_STEPS;	// lowest 'notch'
 		fb[6].g = 256/PWM_STEPS;
 		fb[12].b = 256/PWM_STEPS;
@@ -411,13 +419,13 @@ void led_test(void)
 		fb[45+12] = 256/PWM_STEPS;
 #else
 		// Nice blend:
-		fb[b].r = b*4;
-		fb[b].g = (b > 30) ? b*2 : 0;
-		fb[b].b = 236-(b*4);
+		fb[b].r = b*4/RING_MULT;
+		fb[b].g = (b > RING_PIXELS/2) ? b*2/RING_MULT : 0;
+		fb[b].b = 236-(b*4/RING_MULT);
 #endif
 	}
 
-	led_fb_to_pwm_buffer(fb, 0);		// No offset, raw pixel positions
+	led_fb_to_pwm_buffer(fb);
 
 	// Opportunity to test performance/overhead of IRQ PWM.
 
@@ -471,14 +479,14 @@ static void testloop(void)
 #else
 				dma_tx(&pwm_data[0][c][pwm_arr_idx]);
 				dma_sync();
-				pwm_arr_idx += 4;
+				pwm_arr_idx += LED_BURST_WORDS;
 				spi_tx_sync();
 #endif
 				b_io(B_LE, 1);
 				b_io(B_LE, 0);
 
 				// Bit positions in each halfword accord with
-				// led_rgb_to_bit
+				// led_map
 
 				// With MCU at 6'oclock, quadrants go clockwise
 				// from MCU, with MCU quadrant being last
@@ -21,11 +21,19 @@
 
 void	led_disp_init(void);
 void	led_test(void);
-// The offset flag causes pixel '0' to appear at 12o'clock (third quadrant, centre pixel)
-// such that the MCU hangs at the bottom, with the drill hole at 6o'clock:
-void	led_fb_to_pwm_buffer(pix_t *fb, int offset_to_12oclock);
+// Pixel '0' appears at 12o'clock however the clock's hung (see ledmap.h):
+void	led_fb_to_pwm_buffer(pix_t *fb);
 
-// Wait for vsync/swap double buffers.  (Internally, does WFI.)
-void	led_fb_vsync_swap(void);
+// Show the encoded buffer from the next refresh.  Each refresh posts
+// EV_VSYNC; don't encode again until led_fb_ready().  Frames are numbered
+// from 1; submit returns the frame's number.
+uint32_t led_fb_submit(void);
+int	led_fb_ready(void);
+// Take back a submitted frame that's not gone up yet, to redraw it now
+// rather than a refresh later.  Returns 1 if there was one (its encoding's
+// still in the buffer), 0 if the buffer was free anyway.
+int	led_fb_reclaim(void);
+// The number of the frame last shown, and TIM2 when it went up:
+uint32_t led_fb_shown(uint32_t *t);
 
 #endif
@@ -0,0 +1,105 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LED_TIMING_H
+#define LED_TIMING_H
+
+#include "hw.h"
+#include "geometry.h"
+
+/* Scan timing, worked out from the length of the driver chain.
+ *
+ * Every PWM tick, TIM14 starts a DMA burst of one halfword per chained
+ * driver to SPI, and the DMA completion IRQ latches it.  That has to be
+ * finished well inside the tick, so the longer the chain the slower the
+ * tick:  the refresh rate is PWM_REFRESH_MAX_HZ, or less if the burst
+ * doesn't fit.  tools/scanmodel.py does the same sums on the host and
+ * prints a table per chain length.
+ *
+ * The SPI clock is the fastest prescale of PCLK that's no faster than
+ * LED_SPI_MAX_HZ; turn that down (e.g. 'make LED_SPI_MAX_HZ=6000000') for
+ * long chains over cables between boards.
+ */
+
+#define PWM_SHIFT 		6
+#define PWM_STEPS 		(1<<PWM_SHIFT)
+// At the end, N 'ticks' are all black, to give time for pullups to
+// settle/discharge/etc. (Observed significant 'bleed' from one run through to
+// the next on a different common pullup, first FET was not switching off fully
+// before second FET was switched on.)
+#define PWM_DEAD_TIME 		1
+#define PWM_TICKS		(RING_THIRDS * (PWM_STEPS + PWM_DEAD_TIME))
+
+#define PWM_REFRESH_MAX_HZ 	300
+// Below this, flicker's visible:
+#define PWM_REFRESH_MIN_HZ 	150
+
+#ifndef LED_SPI_MAX_HZ
+#define LED_SPI_MAX_HZ		24000000	// Drivers are good for 30MHz
+#endif
+
+// Halfwords per burst:
+#define LED_BURST_WORDS		RING_DRIVERS
+#define LED_BURST_BITS		(LED_BURST_WORDS * 16)
+
+// SPI1 runs from PCLK (= SYS_CLK); BR = log2(divide) - 1:
+#if LED_SPI_MAX_HZ >= SYS_CLK/2
+#define LED_SPI_BR		0
+#elif LED_SPI_MAX_HZ >= SYS_CLK/4
+#define LED_SPI_BR		1
+#elif LED_SPI_MAX_HZ >= SYS_CLK/8
+#define LED_SPI_BR		2
+#elif LED_SPI_MAX_HZ >= SYS_CLK/16
+#define LED_SPI_BR		3
+#elif LED_SPI_MAX_HZ >= SYS_CLK/32
+#define LED_SPI_BR		4
+#elif LED_SPI_MAX_HZ >= SYS_CLK/64
+#define LED_SPI_BR		5
+#elif LED_SPI_MAX_HZ >= SYS_CLK/128
+#define LED_SPI_BR		6
+#else
+#define LED_SPI_BR		7
+#endif
+#define LED_SPI_DIV		(2 << LED_SPI_BR)
+
+/* Core cycles per tick besides the shifting itself:  both IRQs' entry and
+ * exit, the DMA reload, waiting for BSY and the LE strobe.  (Roughly, from
+ * the handlers; the DMA only starts once TIM14's IRQ has got going.)
+ * A burst may take up to 3/4 of the tick, leaving slack for IRQ latency.
+ */
+#define LED_TICK_OVERHEAD	150
+#define LED_BURST_CYCLES	(LED_BURST_BITS * LED_SPI_DIV + LED_TICK_OVERHEAD)
+#define PWM_REFRESH_FIT_HZ	((SYS_CLK / 4 * 3) / (PWM_TICKS * LED_BURST_CYCLES))
+
+#if PWM_REFRESH_FIT_HZ < PWM_REFRESH_MAX_HZ
+#define PWM_REFRESH_HZ 		PWM_REFRESH_FIT_HZ
+#else
+#define PWM_REFRESH_HZ 		PWM_REFRESH_MAX_HZ
+#endif
+
+#if PWM_REFRESH_HZ < PWM_REFRESH_MIN_HZ
+#error "Driver chain too long to shift out in a PWM tick; raise LED_SPI_MAX_HZ or shorten the chain"
+#endif
+
+// TIM14 counts at SYS_CLK/2:
+#define PWM_TIMER_CLK		(SYS_CLK / 2)
+#define PWM_TIMER_HZ 		(PWM_REFRESH_HZ * PWM_TICKS)
+
+#if (PWM_TIMER_CLK / PWM_TIMER_HZ) > 0xffff
+#error "PWM tick too long for TIM14"
+#endif
+
+#endif
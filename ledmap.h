@@ -0,0 +1,40 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LEDMAP_H
+#define LEDMAP_H
+
+#include <inttypes.h>
+#include "geometry.h"
+
+/* Where each framebuffer pixel lives in the scan:  the third (common FET),
+ * the driver's word in each DMA burst, and the driver output bit for each of
+ * R, G and B.
+ *
+ * The table is generated (ledmap.c, by tools/mkledmap.py) for the PCB
+ * revision and the way the clock is hung:  'make LED_ROTATE=15' for the
+ * MCU at 9 o'clock, LED_MIRROR=1 for a board mounted facing the other way.
+ * Pixel 0 always comes out at 12 o'clock.
+ */
+typedef struct {
+	uint8_t		third;
+	uint8_t		word;
+	uint16_t	mask[3];	// R, G, B
+} led_map_t;
+
+extern const led_map_t led_map[RING_PIXELS];
+
+#endif
@@ -24,6 +24,8 @@
 #include "time.h"
 #include "uart.h"	// for printf, etc.
 #include "flashvars.h"
+#include "rtc.h"
+#include <stm32f0xx_rtc.h>
 
 // Bright light shining on it:
 #define LDR_ADC_PRACTICAL_MAX	0x500
@@ -42,22 +44,35 @@ static 	uint16_t	adc_avg_val = 0;
 static 	int		adc_sum = 0;
 static 	int		adc_wr_pos = 0;
 
+static work_t	avg_work;
+
 static void 	ls_tcb(uint64_t t_now)
 {
 	ADC1->CR |= ADC_CR_ADSTART;
 }
 
+// Deferred from the IRQ:
+static void	ls_average(work_t *w)
+{
+	adc_sum -= adc_avg[adc_wr_pos];
+	adc_avg[adc_wr_pos] = adc_val;
+	adc_sum += adc_val;
+	adc_wr_pos = (adc_wr_pos + 1) & (AVG_POS - 1);
+	adc_avg_val = adc_sum / AVG_POS;
+	// Kept for a warm restart, every lap of the average (~0.8s):
+	if (adc_wr_pos == 0)
+		RTC_WriteBackupRegister(RTC_BKP_LIGHT,
+					adc_avg_val | RTC_BKP_VALID);
+}
+
 void 	ADC1_COMP_IRQHandler(void)
 {	
 	uint32_t isr = ADC1->ISR;
 	if (isr & ADC_ISR_EOC) {
+		// Just grab the sample; a conversion's only started every
+		// 50ms, so it's long gone by the next.
 		adc_val = ADC1->DR;
-
-		adc_sum -= adc_avg[adc_wr_pos];
-		adc_avg[adc_wr_pos] = adc_val;
-		adc_sum += adc_val;
-		adc_wr_pos = (adc_wr_pos + 1) & (AVG_POS - 1);
-		adc_avg_val = adc_sum / AVG_POS;
+		work_schedule(&avg_work);
 	}
 	if (isr & ADC_ISR_EOSEQ) {
 		// Sequence of one...
@@ -148,9 +163,23 @@ void 	lightsense_init(void)
 	ADC1->CR |= ADC_CR_ADEN;
 	while (!(ADC1->ISR & ADC_ISR_ADRDY)) {}
 
+	// A warm boot picks up the light level from before, rather than
+	// starting dark and fading up as the average fills:
+	if (rtc_warm_boot()) {
+		uint32_t l = RTC_ReadBackupRegister(RTC_BKP_LIGHT);
+
+		if (l & RTC_BKP_VALID) {
+			adc_avg_val = l & 0xffff;
+			for (int i = 0; i < AVG_POS; i++)
+				adc_avg[i] = adc_avg_val;
+			adc_sum = adc_avg_val * AVG_POS;
+		}
+	}
+
 	ADC1->IER |= ADC_IER_EOSEQIE | ADC_IER_EOCIE;
+	avg_work.fn = ls_average;
 	NVIC_EnableIRQ(ADC1_COMP_IRQn);
-	NVIC_SetPriority(ADC1_COMP_IRQn, 0);
+	NVIC_SetPriority(ADC1_COMP_IRQn, IRQ_PRIO_TICK);
 
 	/* Discontig; stop at end of sample sweep, wait for data read, auto
 	 * off */
@@ -1,6 +1,6 @@
 /* Copyright (c) 2014 Matt Evans
  *
- * lookuptables:  Simple sine table.
+ * lookuptables:  Interpolated lookup in the quarter-wave sine table.
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,6 +18,20 @@
 
 #include "lookuptables.h"
 
-const short sintab[SINTAB_ENTRIES] = {
-0x0000, 0x0192, 0x0324, 0x04b6, 0x0647, 0x07d9, 0x096a, 0x0afb, 0x0c8b, 0x0e1b, 0x0fab, 0x1139, 0x12c7, 0x1455, 0x15e1, 0x176d, 0x18f8, 0x1a82, 0x1c0b, 0x1d93, 0x1f19, 0x209f, 0x2223, 0x23a6, 0x2527, 0x26a7, 0x2826, 0x29a3, 0x2b1e, 0x2c98, 0x2e10, 0x2f86, 0x30fb, 0x326d, 0x33de, 0x354d, 0x36b9, 0x3824, 0x398c, 0x3af2, 0x3c56, 0x3db7, 0x3f16, 0x4073, 0x41cd, 0x4325, 0x447a, 0x45cc, 0x471c, 0x4869, 0x49b3, 0x4afa, 0x4c3f, 0x4d80, 0x4ebf, 0x4ffa, 0x5133, 0x5268, 0x539a, 0x54c9, 0x55f4, 0x571d, 0x5842, 0x5963, 0x5a81, 0x5b9c, 0x5cb3, 0x5dc6, 0x5ed6, 0x5fe2, 0x60eb, 0x61f0, 0x62f1, 0x63ee, 0x64e7, 0x65dd, 0x66ce, 0x67bc, 0x68a5, 0x698b, 0x6a6c, 0x6b4a, 0x6c23, 0x6cf8, 0x6dc9, 0x6e95, 0x6f5e, 0x7022, 0x70e1, 0x719d, 0x7254, 0x7306, 0x73b5, 0x745e, 0x7503, 0x75a4, 0x7640, 0x76d8, 0x776b, 0x77f9, 0x7883, 0x7908, 0x7989, 0x7a04, 0x7a7c, 0x7aee, 0x7b5c, 0x7bc4, 0x7c29, 0x7c88, 0x7ce2, 0x7d38, 0x7d89, 0x7dd5, 0x7e1c, 0x7e5e, 0x7e9c, 0x7ed4, 0x7f08, 0x7f37, 0x7f61, 0x7f86, 0x7fa6, 0x7fc1, 0x7fd7, 0x7fe8, 0x7ff5, 0x7ffc, 0x7fff, 0x7ffc, 0x7ff5, 0x7fe8, 0x7fd7, 0x7fc1, 0x7fa6, 0x7f86, 0x7f61, 0x7f37, 0x7f08, 0x7ed4, 0x7e9c, 0x7e5e, 0x7e1c, 0x7dd5, 0x7d89, 0x7d38, 0x7ce2, 0x7c88, 0x7c29, 0x7bc4, 0x7b5c, 0x7aee, 0x7a7c, 0x7a04, 0x7989, 0x7908, 0x7883, 0x77f9, 0x776b, 0x76d8, 0x7640, 0x75a4, 0x7503, 0x745e, 0x73b5, 0x7306, 0x7254, 0x719d, 0x70e1, 0x7022, 0x6f5e, 0x6e95, 0x6dc9, 0x6cf8, 0x6c23, 0x6b4a, 0x6a6c, 0x698b, 0x68a5, 0x67bc, 0x66ce, 0x65dd, 0x64e7, 0x63ee, 0x62f1, 0x61f0, 0x60eb, 0x5fe2, 0x5ed6, 0x5dc6, 0x5cb3, 0x5b9c, 0x5a81, 0x5963, 0x5842, 0x571d, 0x55f4, 0x54c9, 0x539a, 0x5268, 0x5133, 0x4ffa, 0x4ebf, 0x4d80, 0x4c3f, 0x4afa, 0x49b3, 0x4869, 0x471c, 0x45cc, 0x447a, 0x4325, 0x41cd, 0x4073, 0x3f16, 0x3db7, 0x3c56, 0x3af2, 0x398c, 0x3824, 0x36b9, 0x354d, 0x33de, 0x326d, 0x30fb, 0x2f86, 0x2e10, 0x2c98, 0x2b1e, 0x29a3, 0x2826, 0x26a7, 0x2527, 0x23a6, 0x2223, 0x209f, 0x1f19, 0x1d93, 0x1c0b, 0x1a82, 0x18f8, 0x176d, 0x15e1, 0x1455, 0x12c7, 0x1139, 0x0fab, 0x0e1b, 0x0c8b, 0x0afb, 0x096a, 0x07d9, 0x0647, 0x04b6, 0x0324, 0x0192, 0x0000, 0xfe6e, 0xfcdc, 0xfb4a, 0xf9b9, 0xf827, 0xf696, 0xf505, 0xf375, 0xf1e5, 0xf055, 0xeec7, 0xed39, 0xebab, 0xea1f, 0xe893, 0xe708, 0xe57e, 0xe3f5, 0xe26d, 0xe0e7, 0xdf61, 0xdddd, 0xdc5a, 0xdad9, 0xd959, 0xd7da, 0xd65d, 0xd4e2, 0xd368, 0xd1f0, 0xd07a, 0xcf05, 0xcd93, 0xcc22, 0xcab3, 0xc947, 0xc7dc, 0xc674, 0xc50e, 0xc3aa, 0xc249, 0xc0ea, 0xbf8d, 0xbe33, 0xbcdb, 0xbb86, 0xba34, 0xb8e4, 0xb797, 0xb64d, 0xb506, 0xb3c1, 0xb280, 0xb141, 0xb006, 0xaecd, 0xad98, 0xac66, 0xab37, 0xaa0c, 0xa8e3, 0xa7be, 0xa69d, 0xa57f, 0xa464, 0xa34d, 0xa23a, 0xa12a, 0xa01e, 0x9f15, 0x9e10, 0x9d0f, 0x9c12, 0x9b19, 0x9a23, 0x9932, 0x9844, 0x975b, 0x9675, 0x9594, 0x94b6, 0x93dd, 0x9308, 0x9237, 0x916b, 0x90a2, 0x8fde, 0x8f1f, 0x8e63, 0x8dac, 0x8cfa, 0x8c4b, 0x8ba2, 0x8afd, 0x8a5c, 0x89c0, 0x8928, 0x8895, 0x8807, 0x877d, 0x86f8, 0x8677, 0x85fc, 0x8584, 0x8512, 0x84a4, 0x843c, 0x83d7, 0x8378, 0x831e, 0x82c8, 0x8277, 0x822b, 0x81e4, 0x81a2, 0x8164, 0x812c, 0x80f8, 0x80c9, 0x809f, 0x807a, 0x805a, 0x803f, 0x8029, 0x8018, 0x800b, 0x8004, 0x8001, 0x8004, 0x800b, 0x8018, 0x8029, 0x803f, 0x805a, 0x807a, 0x809f, 0x80c9, 0x80f8, 0x812c, 0x8164, 0x81a2, 0x81e4, 0x822b, 0x8277, 0x82c8, 0x831e, 0x8378, 0x83d7, 0x843c, 0x84a4, 0x8512, 0x8584, 0x85fc, 0x8677, 0x86f8, 0x877d, 0x8807, 0x8895, 0x8928, 0x89c0, 0x8a5c, 0x8afd, 0x8ba2, 0x8c4b, 0x8cfa, 0x8dac, 0x8e63, 0x8f1f, 0x8fde, 0x90a2, 0x916b, 0x9237, 0x9308, 0x93dd, 0x94b6, 0x9594, 0x9675, 0x975b, 0x9844, 0x9932, 0x9a23, 0x9b19, 0x9c12, 0x9d0f, 0x9e10, 0x9f15, 0xa01e, 0xa12a, 0xa23a, 0xa34d, 0xa464, 0xa57f, 0xa69d, 0xa7be, 0xa8e3, 0xaa0c, 0xab37, 0xac66, 0xad98, 0xaecd, 0xb006, 0xb141, 0xb280, 0xb3c1, 0xb506, 0xb64d, 0xb797, 0xb8e4, 0xba34, 0xbb86, 0xbcdb, 0xbe33, 0xbf8d, 0xc0ea, 0xc249, 0xc3aa, 0xc50e, 0xc674, 0xc7dc, 0xc947, 0xcab3, 0xcc22, 0xcd93, 0xcf05, 0xd07a, 0xd1f0, 0xd368, 0xd4e2, 0xd65d, 0xd7da, 0xd959, 0xdad9, 0xdc5a, 0xdddd, 0xdf61, 0xe0e7, 0xe26d, 0xe3f5, 0xe57e, 0xe708, 0xe893, 0xea1f, 0xebab, 0xed39, 0xeec7, 0xf055, 0xf1e5, 0xf375, 0xf505, 0xf696, 0xf827, 0xf9b9, 0xfb4a, 0xfcdc, 0xfe6e
-};
+// Linearly interpolated lookup; a is in 1/65536 of a turn (so 128 steps
+// between table entries).
+int	sin16(uint16_t a)
+{
+	const short *tab = sintab_q;
+	int p = a & 0x3fff;		// Position within quadrant
+	int i, f, v;
+
+	if (a & 0x4000)			// 2nd/4th quadrants run backwards
+		p = 0x4000 - p;
+	i = p >> 7;
+	f = p & 0x7f;
+	v = tab[i];
+	if (f)				// (Never true at i == 128)
+		v += ((tab[i+1] - v) * f) >> 7;
+	return (a & 0x8000) ? -v : v;
+}
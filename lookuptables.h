@@ -17,13 +17,34 @@
 #ifndef lookuptables_H
 #define lookuptables_H
 
+#include <inttypes.h>
+#include "assets.h"
+
 #define SINTAB_SHIFT 15		/* Note: range -1/+1 in a 16-bit type */
-#define SINTAB_ENTRIES 512 /* 512 steps for 360 degrees; could obv. only store 90deg... */
-extern const short sintab[];
+#define SINTAB_ENTRIES 512 /* 512 steps for 360 degrees, as SIN()/COS() see it */
+#define SINTAB_Q_ENTRIES 129	/* ...but only 0-90deg inclusive is stored */
+/* The table's in the asset store (assets/sintab.txt): */
+#define sintab_q	((const short *)asset_get(ASSET_SINTAB))
+
+/* Flip bits in index to look up in the table of 0-90 degrees. */
+static inline int sin512(unsigned int x)
+{
+	int p = x & 0x7f;
+	int v;
+
+	if (x & 0x80)
+		p = 0x80 - p;
+	v = sintab_q[p];
+	return (x & 0x100) ? -v : v;
+}
+
+#define SIN(x) sin512(x)
+#define COS(x) sin512((x) + (SINTAB_ENTRIES/4))
 
-/* These can easily flip bits in index to v. quickly look up in table of 0-90degrees. */
-#define SIN(x) ((int)sintab[(x) & (SINTAB_ENTRIES-1)])
-#define COS(x) ((int)sintab[((x) + (SINTAB_ENTRIES/4)) & (SINTAB_ENTRIES-1)])
+/* Higher angular precision, interpolated:  a in 1/65536 turn. */
+int	sin16(uint16_t a);
+#define SIN16(a) sin16(a)
+#define COS16(a) sin16((a) + 0x4000)
 
 
 #endif
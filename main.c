@@ -17,11 +17,19 @@
  */
 
 #include "types.h"
+#include "geometry.h"
 #include "rtc.h"
 #include "display_effects.h"
 #include "input.h"
 #include "time.h"
 #include "lightsense.h"
+#include "anim.h"
+#include "assets.h"
+#include "evloop.h"
+#include "boot.h"
+#ifdef BENCH
+#include "bench.h"
+#endif
 
 #ifdef SIM
 #include <stdio.h>
@@ -31,6 +39,7 @@
 #ifndef SIM
 #include "hw.h"
 #include "led_disp.h"
+#include "uart.h"
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -41,17 +50,48 @@ enum { ST_NORMAL, ST_SET_TIME_H, ST_SET_TIME_M, ST_SET_BRI_MAX, ST_SET_BRI_MIN }
 static int state = ST_NORMAL;
 static int st_cur;
 
+// Flash writes take a while; do them after the next frame's drawn:
+static work_t save_work;
+
 ////////////////////////////////////////////////////////////////////////////////
 
-static void update_display(unsigned int framenum)
+// The hour last seen by hour_chime(), or -1 before the first frame:
+static int chime_hour = -1;
+
+/* Play the chime over the face on the hour.  Only an hour ticking over by
+ * itself chimes; the hour at boot, or one set from the UI, is just noted.
+ */
+static void hour_chime(tod_t *time)
+{
+	if (time->hour == chime_hour)
+		return;
+	if (chime_hour >= 0 && time->min == 0)
+		anim_play(asset_get(ASSET_ANIM_CHIME), ANIM_OVER);
+	chime_hour = time->hour;
+}
+
+// Returns 0 if the previous frame was left on display, 1 if a new one was
+// drawn.
+static int update_display(void)
 {
-	pix_t fb_data[60];
+	pix_t fb_data[RING_PIXELS];
 
 	switch (state) {
 	case ST_NORMAL: {
 		tod_t time;
+		int mode;
+
 		rtc_gettime(&time);
-		display_draw(fb_data, framenum, &time);
+		hour_chime(&time);
+		mode = anim_playing();
+		if (mode != ANIM_INSTEAD &&
+		    !display_draw(fb_data, &time))
+			return 0;
+		// An animation drawn instead of the face may end here, leaving
+		// fb_data empty; draw the face after all:
+		if (!anim_draw(fb_data) && mode == ANIM_INSTEAD &&
+		    !display_draw(fb_data, &time))
+			return 0;
 	} break;
 	case ST_SET_TIME_H: {
 		uint32_t t = (uint32_t)time_getglobal();
@@ -74,20 +114,29 @@ static void update_display(unsigned int framenum)
 	}
 
 #ifdef SIM
+	display_frame_done();	// (sim_disp_sync() waits for host vsync)
 	sim_disp_sync(fb_data);
 #else
-	led_fb_to_pwm_buffer(fb_data, 1);
+	led_fb_to_pwm_buffer(fb_data);
+	display_frame_done();
 #endif
+	return 1;
 }
 
-static void process_input(void)
+static void save_limits(work_t *w)
+{
+	lightsense_save_limits();
+}
+
+// One UI event; returns 0 if it did nothing:
+static int handle_input(InputEvent e)
 {
 	// display_next/display_prev
 	int i;
 	static tod_t time;
 
 	if (state == ST_NORMAL) {
-		switch (input_get_event()) {
+		switch (e) {
 		case IE_RUP:
 			display_next();
 			break;
@@ -100,10 +149,10 @@ static void process_input(void)
 			state = ST_SET_TIME_H;
 		} break;
 		default:
-			break;
+			return 0;
 		}
 	} else if (state == ST_SET_TIME_H) {
-		switch (input_get_event()) {
+		switch (e) {
 			// This is very basic; a 'hold' would be nice
 			// for acceleration or a fast-tick mode.
 		case IE_RUP:
@@ -125,10 +174,10 @@ static void process_input(void)
 		} break;
 
 		default:
-			break;
+			return 0;
 		}
 	} else if (state == ST_SET_TIME_M) {
-		switch (input_get_event()) {
+		switch (e) {
 		case IE_RUP:
 			if (++st_cur > 59)
 				st_cur = 0;
@@ -141,14 +190,16 @@ static void process_input(void)
 			time.min = st_cur;
 			time.sec = 0;
 			time.subsec = 0;
+			time.frac = 0;
 			rtc_settime(&time);
+			chime_hour = time.hour;
 			state = ST_NORMAL;
 		} break;
 		default:
-			break;
+			return 0;
 		}
 	} else if (state == ST_SET_BRI_MAX) {
-		switch (input_get_event()) {
+		switch (e) {
 		case IE_RUP:
 			st_cur += 8;
 			if (st_cur > 255)
@@ -166,14 +217,14 @@ static void process_input(void)
 			st_cur = lightsense_get_min();
 		} break;
 		case IE_BHOLD: {
-			lightsense_save_limits();
+			ev_defer(&save_work);
 			state = ST_NORMAL;
 		} break;
 		default:
-			break;
+			return 0;
 		}
 	} else if (state == ST_SET_BRI_MIN) {
-		switch (input_get_event()) {
+		switch (e) {
 		case IE_RUP:
 			st_cur += 8;
 			if (st_cur > 255)
@@ -191,25 +242,110 @@ static void process_input(void)
 			st_cur = lightsense_get_max();
 		} break;
 		case IE_BHOLD: {
-			lightsense_save_limits();
+			ev_defer(&save_work);
 			state = ST_NORMAL;
 		} break;
 		default:
-			break;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+#ifndef SIM
+// Button to photon:  the earliest stamp of the events that went into frame
+// lat_frame, until it's been shown.
+static uint32_t	lat_t0;
+static uint32_t	lat_in;		// This lot's earliest stamp
+static uint32_t	lat_frame;
+static uint8_t	lat_pending;
+
+static void photon_check(void)
+{
+	uint32_t t;
+
+	if (lat_pending && (int32_t)(led_fb_shown(&t) - lat_frame) >= 0) {
+		input_photon(t - lat_t0);
+		lat_pending = 0;
+	}
+}
+#endif
+
+// EV_INPUT:  everything that's queued, in order.  Then, rather than wait
+// for the next EV_VSYNC (and the refresh after that) to show the result,
+// draw it straight away, taking back the frame that's waiting if need be.
+static void process_input(void)
+{
+	input_rec_t r;
+	int acted = 0;
+
+	while (input_get(&r)) {
+		if (handle_input(r.event) && !acted) {
+#ifndef SIM
+			lat_in = r.t;
+#endif
+			acted = 1;
 		}
 	}
+#ifndef SIM
+	if (acted) {
+		// A reclaimed frame's still encoded, so goes back even if
+		// nothing's changed:
+		int had = led_fb_reclaim();
+
+		if (update_display() || had) {
+			if (!lat_pending)
+				lat_t0 = lat_in;
+			lat_frame = led_fb_submit();
+			lat_pending = 1;
+		}
+	}
+#endif
 }
 
-static void wait_vsync(void)
+// EV_VSYNC:  the LEDs have moved on to the last frame, so draw the next
+// into the free buffer.
+static void on_vsync(void)
 {
 #ifndef SIM
-	// Wait for vsync; WFI and check flag
-	// Double-buffer, as we now update new buffer whilst
-	// old one is being drawn.
-	led_fb_vsync_swap();
+	static uint8_t first = 1;
+
+	photon_check();
+	if (!led_fb_ready())
+		return;
+	if (update_display()) {
+		led_fb_submit();
+		if (first) {
+			boot_mark("first frame");
+			boot_report();
+			first = 0;
+		}
+	}
+#else
+	update_display();
 #endif
 }
 
+#if defined(BENCH) && !defined(SIM)
+// EV_TIMER:  print the loop's stats now and then.
+static time_callback_t debug_tcb;
+
+static void debug_tcb_fn(uint64_t t_now)
+{
+	ev_post(EV_TIMER);
+}
+
+static void on_timer(void)
+{
+	work_debug();
+	rtc_debug();
+	input_debug();
+	hw_hsi_debug();
+	ev_debug_stats();
+	display_debug_stats();
+}
+#endif
+
 int main(
 #ifdef SIM
 	int argc, char *argv[]
@@ -218,33 +354,52 @@ int main(
 #endif
 	)
 {
-	unsigned int frames = 0;
-
 #ifndef SIM
 	// HW clocks/PLL init
 	hw_init();
 	// Also, init timers/debug/input before the rest.
 #endif
+	if (!assets_init()) {
+		// No tables or faces to draw with; 'make flash_assets'.
+		while (1)
+			;
+	}
+	boot_mark("assets");
 	rtc_init();
 	// Display uses rtc (to get the saved state); init last:
 	display_init();
+	boot_mark("rtc, display");
+
+#ifdef BENCH
+	// Before the scan IRQs start:
+	bench_run();
+#endif
+
+	// A warm restart goes straight back to the face it was showing:
+	if (!rtc_warm_boot())
+		anim_play(asset_get(ASSET_ANIM_SPLASH), ANIM_INSTEAD);
 
 #ifdef SIM
 	sim_disp_init(argc, argv);
 #else
 	led_disp_init();
+	boot_mark("led_disp");
 
 //	Nein!
 //	led_test();
 #endif
 
-	while(1) {
-		process_input();
-		update_display(frames++);
-		wait_vsync();
+	ev_handler(EV_VSYNC, on_vsync);
+	ev_handler(EV_INPUT, process_input);
+#if defined(BENCH) && !defined(SIM)
+	ev_handler(EV_TIMER, on_timer);
+	debug_tcb.callback = debug_tcb_fn;
+	debug_tcb.period = 5000;
+	time_callback_periodic(&debug_tcb);
+#endif
+	save_work.fn = save_limits;
 
-		// Misc debug callbacks here
-	}
+	ev_run();
 
 	return 0;
 }
@@ -19,21 +19,263 @@
 #include <stm32f0xx_rtc.h>
 #include <stm32f0xx_rcc.h>
 #include <stm32f0xx_pwr.h>
+#include "hw.h"
 #include "rtc.h"
-// Temporary, for fake rtc:
 #include "time.h"
+#include "work.h"
+#include "tod.h"
+#include "uart.h"	// for printf
+// Temporary, for fake rtc:
 #include "input.h"
 
 static int fast = 0;
 static time_callback_t tcb;
-static uint64_t tus_now = 0;
+static tod_counter_t fast_tod;
+
+/* The time of day is cached, rather than read from the RTC every frame:
+ * Alarm A, with every field masked, interrupts as each second starts, and
+ * the IRQ steps the cached time on and stamps TIM2.  The fraction is then
+ * interpolated from TIM2 since the stamp, so rtc_gettime() is a few loads.
+ * (The F051's RTC has no periodic wakeup timer; the alarm does the same.)
+ *
+ * Once a minute, mid-second (when the shadow registers are settled), the
+ * cache is checked against the RTC and reloaded if it's gone astray.
+ */
+typedef struct {
+	uint8_t		hour;	// 1-12, as the RTC counts
+	uint8_t		min;
+	uint8_t		sec;
+	uint8_t		pm;
+} rtc_cache_t;
+
+static volatile rtc_cache_t	cache;
+static volatile uint32_t	t_sec;		// TIM2 at the start of the second
+static time_callback_t		check_tcb;
+static uint32_t			resyncs;
+
+// HSI calibration:  TIM2 cycles over HSI_CAL_SECS seconds of LSE.
+static uint32_t			cal_sum;
+static uint8_t			cal_n;
+static volatile uint8_t		cal_skip;
+static int32_t			cal_err;
+static work_t			cal_work;
+
+static void rtc_cache_load(void)
+{
+	RTC_TimeTypeDef rtct;
+
+	RTC_WaitForSynchro();
+	RTC_GetTime(RTC_Format_BIN, &rtct);
+	__disable_irq();
+	cache.hour = rtct.RTC_Hours;
+	cache.min = rtct.RTC_Minutes;
+	cache.sec = rtct.RTC_Seconds;
+	cache.pm = rtct.RTC_H12 != RTC_H12_AM;
+	__enable_irq();
+}
+
+// From a one-shot timer (PendSV), half a second after the minute:
+static void rtc_check(uint64_t t_now)
+{
+	RTC_TimeTypeDef rtct;
+	rtc_cache_t c;
+
+	RTC_GetTime(RTC_Format_BIN, &rtct);
+	__disable_irq();
+	c = cache;
+	__enable_irq();
+	if (c.hour != rtct.RTC_Hours || c.min != rtct.RTC_Minutes ||
+	    c.sec != rtct.RTC_Seconds || c.pm != (rtct.RTC_H12 != RTC_H12_AM)) {
+		resyncs++;
+		rtc_cache_load();
+	}
+}
+
+static void rtc_cal_work(work_t *w)
+{
+	hw_hsi_trim(cal_err);
+	// The second the trim changed in is neither one thing nor the other:
+	cal_skip = 1;
+}
+
+// From the IRQ, with the length of the last second in TIM2 cycles:
+static void rtc_cal_sample(uint32_t period)
+{
+	// Skip odd seconds (settime, a missed IRQ), and start over:
+	if (cal_skip || period < SYS_CLK - SYS_CLK/50 ||
+	    period > SYS_CLK + SYS_CLK/50) {
+		cal_skip = 0;
+		cal_n = 0;
+		cal_sum = 0;
+		return;
+	}
+	cal_sum += period;
+	if (++cal_n == HSI_CAL_SECS) {
+		cal_err = cal_sum - HSI_CAL_SECS * SYS_CLK;
+		cal_n = 0;
+		cal_sum = 0;
+		work_schedule(&cal_work);
+	}
+}
+
+void RTC_IRQHandler(void)
+{
+	uint32_t now = time_getfine();
+
+	if (RTC->ISR & RTC_ISR_ALRAF) {
+		RTC_ClearITPendingBit(RTC_IT_ALRA);
+		rtc_cal_sample(now - t_sec);
+		t_sec = now;
+		if (++cache.sec == 60) {
+			cache.sec = 0;
+			if (++cache.min == 60) {
+				cache.min = 0;
+				// 11:59:59 AM -> 12:00:00 PM -> 1:00:00 PM
+				if (++cache.hour == 13)
+					cache.hour = 1;
+				else if (cache.hour == 12)
+					cache.pm ^= 1;
+			}
+			time_callback_once(&check_tcb, 500);
+		}
+	}
+	EXTI->PR = EXTI_PR_PR17;
+}
+
+static void rtc_alarm_init(void)
+{
+	RTC_AlarmTypeDef rtca;
+
+	RTC_AlarmCmd(RTC_Alarm_A, DISABLE);
+	RTC_AlarmStructInit(&rtca);
+	rtca.RTC_AlarmMask = RTC_AlarmMask_All;
+	RTC_SetAlarm(RTC_Format_BIN, RTC_Alarm_A, &rtca);
+	// No sub-second match:  fires as the seconds count on.
+	RTC_AlarmSubSecondConfig(RTC_Alarm_A, 0, RTC_AlarmSubSecondMask_All);
+	RTC_ClearITPendingBit(RTC_IT_ALRA);
+	RTC_ITConfig(RTC_IT_ALRA, ENABLE);
+
+	// The alarm reaches the NVIC through EXTI line 17:
+	EXTI->PR = EXTI_PR_PR17;
+	EXTI->RTSR |= EXTI_RTSR_TR17;
+	EXTI->IMR |= EXTI_IMR_MR17;
+
+	check_tcb.callback = rtc_check;
+	cal_work.fn = rtc_cal_work;
+	cal_skip = 1;
+
+	rtc_cache_load();
+	t_sec = time_getfine();
+	NVIC_SetPriority(RTC_IRQn, IRQ_PRIO_TICK);
+	NVIC_EnableIRQ(RTC_IRQn);
+	RTC_AlarmCmd(RTC_Alarm_A, ENABLE);
+}
+
+/* On a cold start the LSE takes a second or two to get going.  Rather than
+ * hold up the display for it, time's kept by a TOD counter stepped from
+ * time_getus() (so on the HSI) until it's ready.  Then the RTC's set up and
+ * takes over at the counter's next second boundary.
+ */
+static volatile uint8_t	lse_ready;
+static tod_counter_t	interim;
+static uint64_t		interim_us;	// time_getus() it's been stepped to
+static time_callback_t	lse_tcb;
+static uint32_t		lse_ms;		// How long the LSE took
+
+// IRQs off:
+static void interim_step(void)
+{
+	uint64_t now = time_getus();
+	uint64_t dt = now - interim_us;
+
+	interim_us = now;
+	while (dt > TOD_MAX_STEP_US) {
+		tod_counter_step(&interim, TOD_MAX_STEP_US);
+		dt -= TOD_MAX_STEP_US;
+	}
+	tod_counter_step(&interim, dt);
+}
+
+static void rtc_hw_settime(tod_t *time)
+{
+	RTC_TimeTypeDef rtct;
+
+	rtct.RTC_H12 = time->amnpm ? RTC_H12_AM : RTC_H12_PM;
+	rtct.RTC_Hours = time->hour;
+	rtct.RTC_Minutes = time->min;
+	rtct.RTC_Seconds = time->sec;
+
+	RTC_SetTime(RTC_Format_BIN, &rtct);
+	// Leaving init mode restarts the second:
+	t_sec = time_getfine();
+	cal_skip = 1;
+	rtc_cache_load();
+}
+
+static void lse_handover(uint64_t t_now)
+{
+	RTC_InitTypeDef rtci;
+	tod_t tod;
+
+	RCC_RTCCLKConfig(RCC_RTCCLKSource_LSE);
+	RCC_RTCCLKCmd(ENABLE);
+	RTC_WaitForSynchro();
+
+	rtci.RTC_AsynchPrediv = 0x7f; // These are the defaults anyway
+	rtci.RTC_SynchPrediv = TIME_RTC_PREDIV_S;
+	rtci.RTC_HourFormat = RTC_HourFormat_12;
+	RTC_Init(&rtci);
+
+	__disable_irq();
+	interim_step();
+	// Called at about the boundary; round to it:
+	if (interim.us >= 500000)
+		tod_counter_step(&interim, 1000000 - interim.us);
+	tod_counter_get(&interim, &tod);
+	__enable_irq();
+	rtc_hw_settime(&tod);
+
+	RTC_WriteBackupRegister(RTC_BKP_MAGIC, 0xdeadbeef);
+	rtc_alarm_init();
+	lse_ready = 1;
+}
+
+// Every LSE_POLL_MS, from PendSV:
+#define LSE_POLL_MS	20
+
+static void lse_poll(uint64_t t_now)
+{
+	uint32_t us;
+
+	if (RCC_GetFlagStatus(RCC_FLAG_LSERDY) == RESET)
+		return;
+	time_callback_cancel(&lse_tcb);
+	lse_ms = t_now;
+
+	__disable_irq();
+	interim_step();
+	us = interim.us;
+	__enable_irq();
+	lse_tcb.callback = lse_handover;
+	time_callback_once(&lse_tcb, time_us_to_ms(1000000 - us));
+}
 
 static void rtc_timer_callback(uint64_t t_now)
 {
 	if (fast)
-		tus_now += 100000;
+		tod_counter_step(&fast_tod, 100000);
 	else
-		tus_now += 10000;
+		tod_counter_step(&fast_tod, 10000);
+}
+
+int rtc_warm_boot(void)
+{
+	// Latched, as a cold boot sets the magic once the LSE's going:
+	static int8_t warm = -1;
+
+	if (warm < 0)
+		warm = RTC_ReadBackupRegister(RTC_BKP_MAGIC) == 0xdeadbeef;
+	return warm;
 }
 
 void rtc_init(void)
@@ -48,76 +290,87 @@ void rtc_init(void)
 	}
 
         // Set up RTC according to periph lib example method:
-	if (RTC_ReadBackupRegister(RTC_BKP_DR0) != 0xdeadbeef) {
-		RTC_InitTypeDef rtci;
-		RTC_TimeTypeDef rtct;
-
+	if (!rtc_warm_boot()) {
 		RCC_APB1PeriphClockCmd(RCC_APB1Periph_PWR, ENABLE);
 		PWR_BackupAccessCmd(ENABLE);
 
+		// Start the LSE, and carry on from midnight without it:
 		RCC_LSEConfig(RCC_LSE_ON);
-		/* Wait for LSE to stabilise */
-		while(RCC_GetFlagStatus(RCC_FLAG_LSERDY) == RESET) { }
-		/* Select LSE */
-		RCC_RTCCLKConfig(RCC_RTCCLKSource_LSE);
-  
-		RCC_RTCCLKCmd(ENABLE);
-
-		RTC_WaitForSynchro();	// What does this do?
-
-		/* Configure the RTC data register and RTC prescaler */
-		rtci.RTC_AsynchPrediv = 0x7f; // These are the defaults anyway
-		rtci.RTC_SynchPrediv = 0xff;
-		rtci.RTC_HourFormat = RTC_HourFormat_12;
-		RTC_Init(&rtci);
-
-		rtct.RTC_H12 = RTC_H12_AM;
-		rtct.RTC_Hours = 0;
-		rtct.RTC_Minutes = 0;
-		rtct.RTC_Seconds = 0;
-		RTC_SetTime(RTC_Format_BIN, &rtct);
-
-		RTC_WriteBackupRegister(RTC_BKP_DR0, 0xdeadbeef);
+		interim_us = time_getus();
+		tod_counter_set(&interim, 0, 0, 0, 0);
+		lse_tcb.callback = lse_poll;
+		lse_tcb.period = LSE_POLL_MS;
+		time_callback_periodic(&lse_tcb);
 	} else {
 		RCC_APB1PeriphClockCmd(RCC_APB1Periph_PWR, ENABLE);
 		PWR_BackupAccessCmd(ENABLE);
 		RTC_WaitForSynchro();
+		rtc_alarm_init();
+		lse_ready = 1;
 	}
 }
 
 void rtc_gettime(tod_t *time_out)
 {
 	if (fast) {
-		// Absolute time to TOD:
-		time_out->hour 	= ((tus_now/1000000) % (12*60*60)) / (60*60);
-		time_out->min  	= ((tus_now/1000000) % (60*60)) / 60;
-		time_out->sec 	= (tus_now/1000000) % 60;
-		time_out->subsec = ((tus_now*64) % 64000000)/1000000;
-		time_out->amnpm = (((tus_now/1000000) % (24*60*60)) /
-				   (60*60)) < 12;
+		tod_counter_t c;
+
+		__disable_irq();
+		c = fast_tod;
+		__enable_irq();
+		tod_counter_get(&c, time_out);
+	} else if (!lse_ready) {
+		tod_counter_t c;
+
+		__disable_irq();
+		interim_step();
+		c = interim;
+		__enable_irq();
+		tod_counter_get(&c, time_out);
 	} else {
-		RTC_TimeTypeDef rtct;
-		RTC_GetTime(RTC_Format_BIN, &rtct);
-		time_out->hour 	= rtct.RTC_Hours;
+		rtc_cache_t c;
+		uint32_t dt;
+
+		__disable_irq();
+		c = cache;
+		dt = time_getfine() - t_sec;
+		__enable_irq();
+		time_out->hour 	= c.hour;
 		if (time_out->hour > 11)
 			time_out->hour -= 12;
-		time_out->min 	= rtct.RTC_Minutes;
-		time_out->sec 	= rtct.RTC_Seconds;
-		// Formula in DS:  (PREDIV_S - SS) / (PREDIV_S + 1)
-		// That's /256, so to give 0-63, /4:
-		time_out->subsec = (0xff - RTC_GetSubSecond()) >> 2;
-		time_out->amnpm = rtct.RTC_H12 == RTC_H12_AM;
+		time_out->min 	= c.min;
+		time_out->sec 	= c.sec;
+		// 65536/48M ~= 5864062/2^32.  HSI's a bit off LSE, so hold
+		// at the end of the second if the IRQ's not been yet:
+		if (dt >= SYS_CLK)
+			time_out->frac = 0xffff;
+		else
+			time_out->frac = ((uint64_t)dt * 5864062) >> 32;
+		time_out->subsec = time_out->frac >> 10;
+		time_out->amnpm = !c.pm;
 	}
 }
 
 void rtc_settime(tod_t *time)
 {
-	RTC_TimeTypeDef rtct;
-
-	rtct.RTC_H12 = time->amnpm ? RTC_H12_AM : RTC_H12_PM;
-	rtct.RTC_Hours = time->hour;
-	rtct.RTC_Minutes = time->min;
-	rtct.RTC_Seconds = time->sec;
+	__disable_irq();
+	if (!lse_ready) {
+		// The handover (in PendSV) will pass this on:
+		interim_us = time_getus();
+		tod_counter_set(&interim, time->hour + (time->amnpm ? 0 : 12),
+				time->min, time->sec, 0);
+		__enable_irq();
+		return;
+	}
+	__enable_irq();
+	rtc_hw_settime(time);
+}
 
-	RTC_SetTime(RTC_Format_BIN, &rtct);
+void rtc_debug(void)
+{
+	if (lse_ready)
+		printf("rtc: %d cache resyncs, LSE took %dms\r\n",
+		       (int)resyncs, (int)lse_ms);
+	else
+		printf("rtc: waiting for LSE\r\n");
 }
@@ -21,6 +21,18 @@
 
 void rtc_init(void);
 
+/* Backup registers (kept over a reset while there's power, like the RTC):
+ * RTC_BKP_MAGIC is 0xdeadbeef once the RTC's been set up.
+ */
+#define RTC_BKP_MAGIC	RTC_BKP_DR0
+#define RTC_BKP_FACE	RTC_BKP_DR1	// Current display
+#define RTC_BKP_HSITRIM	RTC_BKP_DR2	// HSITRIM | RTC_BKP_VALID
+#define RTC_BKP_LIGHT	RTC_BKP_DR3	// Light level average | RTC_BKP_VALID
+#define RTC_BKP_VALID	0x10000
+
+// A reset with the RTC (and the backup registers) still going:
+int rtc_warm_boot(void);
+
 // Was softboot
 
 typedef struct {
@@ -29,10 +41,13 @@ typedef struct {
 	uint8_t		sec;	// 0-59
 	uint8_t		subsec;	// 0-63
 	uint8_t		amnpm;
+	uint16_t	frac;	// 0-65535, fraction of the second (subsec is
+				// the top 6 bits)
 } tod_t;
 
 void rtc_gettime(tod_t *time_out);
 void rtc_settime(tod_t *time);
+void rtc_debug(void);
 
 // Misc:  Get whether cold/warm restart?
 
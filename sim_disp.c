@@ -17,6 +17,7 @@
  */
 
 #include "types.h"
+#include "geometry.h"
 #include <SDL.h>
 
 #ifdef __APPLE__
@@ -34,6 +35,8 @@ static const int s_width = 1100;
 static const int s_height = 800;
 
 static const int l_size = 30;
+// LEDs get narrower on bigger rings:
+static const int l_width = 30 / RING_MULT;
 static int radius;
 
 static int sim_disp_evt = 0;
@@ -143,7 +146,7 @@ void sim_disp_sync(pix_t *fb)
 
 	glTranslatef(s_width/2, s_height/2, 0);
 
-	for (i = 0; i < 60; i++) {
+	for (i = 0; i < RING_PIXELS; i++) {
 		const int grey = 0;
 		unsigned int r, g, b;
 
@@ -154,20 +157,20 @@ void sim_disp_sync(pix_t *fb)
 
 		glPushMatrix();
 
-		glRotatef(90+i*6, 0, 0, -1);
+		glRotatef(90+i*(360.0/RING_PIXELS), 0, 0, -1);
 
 		glTranslatef(-radius, 0, 0);
 
 		/* Send our triangle data to the pipeline. */
 		glBegin( GL_QUADS );
 		glColor4ub(fb[i].r, fb[i].g, fb[i].b, 255 );
-		glVertex3i(-l_size, -(l_size/2), 0 );
+		glVertex3i(-l_size, -(l_width/2), 0 );
 		glColor4ub(grey, grey, grey, 255 );
-		glVertex3i(l_size, -(l_size/2), 0);
+		glVertex3i(l_size, -(l_width/2), 0);
 		glColor4ub(grey, grey, grey, 255 );
-		glVertex3i(l_size, (l_size/2), 0);
+		glVertex3i(l_size, (l_width/2), 0);
 		glColor4ub(fb[i].r, fb[i].g, fb[i].b, 255 );
-		glVertex3i(-l_size, (l_size/2), 0);
+		glVertex3i(-l_size, (l_width/2), 0);
 		glEnd();
 		glPopMatrix();
 	}
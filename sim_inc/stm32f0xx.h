@@ -0,0 +1,60 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIM_STM32F0XX_H
+#define SIM_STM32F0XX_H
+
+#include <inttypes.h>
+
+/* Just enough of the device header to build time.c on the host, against the
+ * model of TIM2 and the NVIC in timetest.c.  Every TIM2 access goes through
+ * model_tim2(), which moves the counter on and takes any IRQ that's due, as
+ * the real thing would between instructions.
+ */
+typedef struct {
+	volatile uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCER;
+	volatile uint32_t CNT, PSC, ARR, CCR1;
+} TIM_TypeDef;
+
+typedef struct {
+	volatile uint32_t APB1ENR;
+} RCC_TypeDef;
+
+TIM_TypeDef	*model_tim2(void);
+extern RCC_TypeDef model_rcc;
+
+#define TIM2			(model_tim2())
+#define RCC			(&model_rcc)
+
+#define TIM_CR1_CEN		0x0001
+#define TIM_DIER_UIE		0x0001
+#define TIM_DIER_CC1IE		0x0002
+#define TIM_SR_UIF		0x0001
+#define TIM_SR_CC1IF		0x0002
+#define TIM_EGR_CC1G		0x0002
+#define RCC_APB1ENR_TIM2EN	0x0001
+
+typedef int IRQn_Type;
+#define TIM2_IRQn		15
+
+void	NVIC_EnableIRQ(IRQn_Type irq);
+void	NVIC_SetPendingIRQ(IRQn_Type irq);
+void	NVIC_SetPriority(IRQn_Type irq, uint32_t prio);
+void	__disable_irq(void);
+void	__enable_irq(void);
+void	__WFI(void);
+
+#endif
@@ -17,6 +17,7 @@
  */
 
 #include "rtc.h"
+#include "tod.h"
 #include <sys/time.h>
 #include <stdlib.h>
 #include <string.h>
@@ -33,7 +34,8 @@ static int run_type = RANDOM;
 
 ////////////////////////////////////////
 
-static uint64_t tus_start;
+static uint64_t tus_last;
+static tod_counter_t tod;
 
 void rtc_init(void)
 {
@@ -50,10 +52,16 @@ void rtc_init(void)
 		else if (strcmp(tv, "RANDOM") == 0)
 			run_type = RANDOM;
 	}
-	if (run_type == RANDOM) {
-		tv_start.tv_sec -= (random() % (60*60*24));
-	}
-	tus_start = (tv_start.tv_sec*1000000) + tv_start.tv_usec;
+	tus_last = ((uint64_t)tv_start.tv_sec*1000000) + tv_start.tv_usec;
+
+	// Where the day starts from (the only divides; it's stepped on after):
+	uint64_t s = 0;
+	if (run_type == REAL_TIME)
+		s = tv_start.tv_sec % (60*60*24);
+	else if (run_type == RANDOM)
+		s = random() % (60*60*24);
+	tod_counter_set(&tod, s / (60*60), (s / 60) % 60, s % 60,
+			run_type == REAL_TIME ? tv_start.tv_usec : 0);
 
 	char *fv = getenv("RUN_FAST");
 	if (fv) {
@@ -63,28 +71,30 @@ void rtc_init(void)
 
 void rtc_gettime(tod_t *time_out)
 {
-	int i;
 	struct timeval now;
-	uint64_t tus_now; 
+	uint64_t tus_now, dt;
 
 	gettimeofday(&now, NULL);
 
-	tus_now = (now.tv_sec*1000000) + now.tv_usec;
-
-	if (run_type != REAL_TIME) {
-		tus_now -= tus_start;
+	tus_now = ((uint64_t)now.tv_sec*1000000) + now.tv_usec;
+	dt = tus_now - tus_last;
+	tus_last = tus_now;
 
-		if (go_fast) {
-			tus_now *= go_fast;
-		}
+	if (run_type != REAL_TIME && go_fast) {
+		dt *= go_fast;
 	}
+	// Big steps only if stopped in a debugger, or very fast:
+	while (dt > TOD_MAX_STEP_US) {
+		tod_counter_step(&tod, TOD_MAX_STEP_US);
+		dt -= TOD_MAX_STEP_US;
+	}
+	tod_counter_step(&tod, dt);
+	tod_counter_get(&tod, time_out);
+}
 
-	// Absolute time to TOD:
-	time_out->hour 		= ((tus_now/1000000) % (12*60*60)) / (60*60);
-	time_out->min   	= ((tus_now/1000000) % (60*60)) / 60;
-	time_out->sec 		= (tus_now/1000000) % 60;
-	time_out->subsec 	= ((tus_now*64) % 64000000)/1000000;
-	time_out->amnpm 	= (((tus_now/1000000) % (24*60*60)) / (60*60)) >= 12;
+int rtc_warm_boot(void)
+{
+	return 0;
 }
 
 void rtc_settime(tod_t *time_out)
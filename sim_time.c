@@ -17,6 +17,7 @@
  */
 
 #include <sys/time.h>
+#include <stddef.h>
 #include <inttypes.h>
 
 uint64_t time_getglobal(void)
@@ -25,3 +26,18 @@ uint64_t time_getglobal(void)
 	gettimeofday(&tv, NULL);
 	return (tv.tv_sec*1000UL) + (tv.tv_usec/1000UL);
 }
+
+// Stands in for TIM2, which counts at the 48MHz core clock:
+uint32_t time_getfine(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint32_t)(((tv.tv_sec*1000000ULL) + tv.tv_usec) * 48);
+}
+
+uint64_t time_getus(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec*1000000ULL) + tv.tv_usec;
+}
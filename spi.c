@@ -20,11 +20,13 @@
 #include <stm32f0xx.h>
 
 #include "hw.h"
+#include "led_timing.h"
 
 /* PA7 = MOSI
  * PA5 = SCK
  *
- * SPI peripheral used to output 64 bits (to 4x 16-bit drivers), manual LE strobe
+ * SPI peripheral used to output a halfword per chained 16-bit driver, manual
+ * LE strobe.  The clock's prescale comes from led_timing.h.
  */
 
 void spi_init(void)
@@ -33,8 +35,8 @@ void spi_init(void)
          * Set AF=0 for PA5 (clk) & PA7 (MOSI)
          * CPOL=0
          * CPHA=0 (normally-zero CLK, rising edge latches)
-         * BR[2:0] -> /4 for 12MHz?  /2 would also work fine, drivers are fast
-         * 				enough.
+         * BR[2:0] -> LED_SPI_BR (/2, 24MHz, unless LED_SPI_MAX_HZ is
+         *		lowered for long chains)
          * BIDIMODE
          * BIDIOE yes (output unless specific input)
          * DS = 9 bits
@@ -53,8 +55,7 @@ void spi_init(void)
                 | SPI_CR1_BIDIOE
                 | SPI_CR1_SSM
                 | SPI_CR1_SSI           // Set SSI & unset when reading?
-//		| SPI_CR1_BR_0  // /4, 12MHz
-//		| SPI_CR1_BR_1  // /8
+                | (LED_SPI_BR * SPI_CR1_BR_0)
                 | SPI_CR1_MSTR;
 
         SPI1->CR2 = SPI_CR2_DS_3 | SPI_CR2_DS_2 |
@@ -107,13 +108,13 @@ void dma_tx(uint16_t *data_ptr)
 		DMA1_Channel3->CCR = 0x2592;
 	}
 
-	/* Now arrange for 4 halfwords to be DMAd
+	/* Now arrange for a halfword per driver to be DMAd
 	 * to SPI:
 	 */
 	DMA1->IFCR = DMA_ISR_TCIF3; /* Clear C3 TCIF */
 	DMA1_Channel3->CPAR = (uintptr_t)&SPI1->DR;
 	DMA1_Channel3->CMAR = (uintptr_t)data_ptr;
-	DMA1_Channel3->CNDTR = 4;	// Num de halfwords?
+	DMA1_Channel3->CNDTR = LED_BURST_WORDS;	// Num de halfwords?
 	/* Hi prio 16 bit transfers (both sides),
 	 * MINC but no PINC, DIR=1 (write periph)
 	 */
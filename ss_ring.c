@@ -0,0 +1,112 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * ss_ring:  Supersampled virtual ring, with box/tent downsampling to the
+ * physical pixels.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "ss_ring.h"
+
+// 1 bit per sample keeps the whole ring at a byte per pixel (RAM is tight, most of it
+// being the PWM buffers) and the box filter becomes a popcount.  8 samples
+// per pixel also happens to be about as many levels as 6-bit PWM shows
+// along a moving edge.
+
+static const uint8_t pop4[16] = {
+	0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+static inline int pop8(uint8_t b)
+{
+	return pop4[b & 0xf] + pop4[b >> 4];
+}
+
+void	ss_clear(ss_ring_t *r)
+{
+	for (int i = 0; i < RING_PIXELS; i++)
+		r->cov[i] = 0;
+}
+
+static void	ss_span(ss_ring_t *r, int start, int end)
+{
+	// Set [start, end), no wrapping; start < end <= SS_POSITIONS
+	int p = start >> 3;
+	int last = (end - 1) >> 3;
+	uint8_t m_first = 0xff << (start & 7);
+	uint8_t m_last = 0xff >> (7 - ((end - 1) & 7));
+
+	if (p == last) {
+		r->cov[p] |= m_first & m_last;
+		return;
+	}
+	r->cov[p++] |= m_first;
+	while (p < last)
+		r->cov[p++] = 0xff;
+	r->cov[last] |= m_last;
+}
+
+void	ss_arc(ss_ring_t *r, int start, int len)
+{
+	if (len <= 0)
+		return;
+	if (len >= SS_POSITIONS)
+		len = SS_POSITIONS;
+
+	while (start < 0)
+		start += SS_POSITIONS;
+	while (start >= SS_POSITIONS)
+		start -= SS_POSITIONS;
+
+	if (start + len > SS_POSITIONS) {
+		ss_span(r, start, SS_POSITIONS);
+		ss_span(r, 0, start + len - SS_POSITIONS);
+	} else {
+		ss_span(r, start, start + len);
+	}
+}
+
+static uint8_t sat_add8(uint8_t a, int b)
+{
+	int i = a + b;
+	return (i > 255) ? 255 : i;
+}
+
+void	ss_resolve(pix_t *fb, const ss_ring_t *r, pix_t colour, int filter)
+{
+	uint8_t prev = r->cov[RING_PIXELS-1];
+
+	for (int i = 0; i < RING_PIXELS; i++) {
+		uint8_t cur = r->cov[i];
+		int lvl;
+
+		if (filter == SS_TENT) {
+			uint8_t next = r->cov[(i == RING_PIXELS-1) ? 0 : i + 1];
+			// Weights 1/2/1 over half-pixel groups; 0-24 -> 0-255
+			lvl = 2*pop8(cur) + pop4[prev >> 4] + pop4[next & 0xf];
+			lvl = (lvl * 85) >> 3;
+		} else {
+			// 0-8 -> 0-256
+			lvl = pop8(cur) << 5;
+		}
+		prev = cur;
+
+		if (lvl == 0)
+			continue;
+		fb[i].r = sat_add8(fb[i].r, (colour.r * lvl) >> 8);
+		fb[i].g = sat_add8(fb[i].g, (colour.g * lvl) >> 8);
+		fb[i].b = sat_add8(fb[i].b, (colour.b * lvl) >> 8);
+	}
+}
@@ -0,0 +1,46 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SS_RING_H
+#define SS_RING_H
+
+#include "types.h"
+#include "geometry.h"
+
+/* Supersampled ring:  8 coverage bits per physical pixel, i.e. 480 positions
+ * around a 60-pixel ring, packed one byte per pixel (bit 0 is the most
+ * anticlockwise sub-position).  Shapes are drawn as coverage then resolved
+ * (downsampled) to the real pixels in a given colour, which anti-aliases them
+ * for free.
+ */
+#define SS_FACTOR	8
+#define SS_POSITIONS	(RING_PIXELS * SS_FACTOR)
+
+typedef struct {
+	uint8_t	cov[RING_PIXELS];
+} ss_ring_t;
+
+enum { SS_BOX, SS_TENT };
+
+void	ss_clear(ss_ring_t *r);
+// Set coverage from 'start' for 'len' positions (in 1/8 pixels, wrapping):
+void	ss_arc(ss_ring_t *r, int start, int len);
+// Downsample to fb, adding colour scaled by coverage (saturating).  SS_BOX
+// averages each pixel's own 8 samples; SS_TENT also takes half of each
+// neighbour, which is softer but hides pixel-crossing 'steps' better.
+void	ss_resolve(pix_t *fb, const ss_ring_t *r, pix_t colour, int filter);
+
+#endif
@@ -21,67 +21,281 @@
 #include "time.h"
 #include "hw.h"
 
+/* Tickless:  there's no 1ms interrupt.  TIM2 free-runs at the core clock and
+ * is the timebase; global_time (ms) is brought up to date from it whenever
+ * it's read or the timer wakes us, and TIM2's compare channel 1 is set for
+ * the earliest timer deadline.  When nothing's due, nothing interrupts
+ * (bar the LED scan).
+ *
+ * TIM2 wraps every ~89s, so the wake-up is never further off than
+ * TIME_MAX_SLEEP_MS, to be sure each wrap's seen.
+ */
+#define CYCLES_PER_MS		(SYS_CLK / 1000)
+#define CYCLES_PER_US		(SYS_CLK / 1000000)
+#define TIME_MAX_SLEEP_MS	60000
 
-volatile uint64_t global_time = 0;
-time_callback_t *cb_list = 0;
+#if CYCLES_PER_US != 48
+#error "time_getus() assumes a 48MHz TIM2"
+#endif
 
+// A TIM2 lap is 2^32 cycles = US_PER_WRAP us and WRAP_REM_CYCLES:
+#define US_PER_WRAP		(0x100000000ULL / CYCLES_PER_US)
+#define WRAP_REM_CYCLES		(0x100000000ULL % CYCLES_PER_US)
 
-void	delay_ms(int d)
+static volatile uint64_t global_time = 0;
+static uint32_t ms_cnt;			// TIM2 count at the start of this ms
+static uint32_t ms_done;		// Last ms the wheel's been run up to
+static time_callback_t *wheel[TIME_WHEEL_SLOTS];
+
+
+/* Catch global_time up with TIM2, keeping the part-ms in ms_cnt.  (No divide
+ * on the M0, so multiply by 2^32/CYCLES_PER_MS, which can come out one
+ * short, and fix up.)  IRQs off.
+ */
+static void	time_update(void)
+{
+	uint32_t d = TIM2->CNT - ms_cnt;
+	uint32_t ms = ((uint64_t)d * (0xffffffffU / CYCLES_PER_MS)) >> 32;
+
+	d -= ms * CYCLES_PER_MS;
+	while (d >= CYCLES_PER_MS) {
+		d -= CYCLES_PER_MS;
+		ms++;
+	}
+	ms_cnt += ms * CYCLES_PER_MS;
+	global_time += ms;
+}
+
+/* The us clock is the us up to the last TIM2 wrap (us_wrap, plus a few
+ * cycles us_rem), and TIM2's count since.  The update IRQ moves those on
+ * with IRQs off, bumping wrap_seq either side; readers don't mask IRQs but
+ * retry if wrap_seq changed under them (i.e. they were interrupted by the
+ * update), the usual seqlock.  A reader at higher priority than the update
+ * (or with IRQs off) can see a wrap before it's been counted, so also
+ * allows for a pending update.
+ */
+static volatile uint32_t wrap_seq;
+static volatile uint64_t us_wrap;
+static volatile uint32_t us_rem;
+
+static inline void	wrap_add(uint64_t *us, uint32_t *rem)
 {
-	uint64_t tn;
+	*us += US_PER_WRAP;
+	*rem += WRAP_REM_CYCLES;
+	if (*rem >= CYCLES_PER_US) {
+		*rem -= CYCLES_PER_US;
+		(*us)++;
+	}
+}
+
+uint64_t time_getus(void)
+{
+	uint32_t seq, cnt, rem, q;
+	uint64_t us;
+
+	do {
+		seq = wrap_seq;
+		us = us_wrap;
+		rem = us_rem;
+		cnt = TIM2->CNT;
+		if ((TIM2->SR & TIM_SR_UIF) && cnt < 0x80000000)
+			wrap_add(&us, &rem);
+	} while (seq != wrap_seq);
+
+	// cnt/48 = (cnt/16)/3 without a divide (exact for 32 bits):
+	q = ((uint64_t)(cnt >> 4) * 0xaaaaaaab) >> 33;
+	cnt -= q * CYCLES_PER_US;
+	if (cnt + rem >= CYCLES_PER_US)
+		q++;
+	return us + q;
+}
+
+uint64_t time_getglobal(void)
+{
+	uint64_t t;
 
 	__disable_irq();
-	tn = global_time;
+	time_update();
+	t = global_time;
 	__enable_irq();
+	return t;
+}
 
-	while ((global_time - tn) < d) {
+static void	callback_work(work_t *w)
+{
+	time_callback_t *c = (time_callback_t *)w;
+
+	// Callbacks are given the time they run, not when they fell due, as
+	// they may have waited behind other work:
+	c->callback(time_getglobal());
+}
+
+void	delay_ms(int d)
+{
+	// Something has to wake the WFI; a timer that does nothing will.
+	static time_callback_t wake;
+	uint64_t tn = time_getglobal();
+
+	wake.callback = 0;
+	while ((time_getglobal() - tn) < d) {
+		time_callback_once(&wake, 1);
 		__WFI();
 	}
+	time_callback_cancel(&wake);
 }
 
 void	delay_us(int d)
 {
-	int i;
-	for (i = 0; i < (d*48/2); i++) 
-	{
-		// Ish... prob.
+	uint32_t t = TIM2->CNT;
+
+	while ((TIM2->CNT - t) < (uint32_t)d * CYCLES_PER_US)
+		;
+}
+
+// These with IRQs off (or from the timer IRQ):
+static void	wheel_add(time_callback_t *c, uint32_t deadline)
+{
+	time_callback_t **slot = &wheel[deadline & (TIME_WHEEL_SLOTS-1)];
+
+	c->deadline = deadline;
+	c->next = *slot;
+	*slot = c;
+}
+
+static void	wheel_remove(time_callback_t *c)
+{
+	time_callback_t **pp = &wheel[c->deadline & (TIME_WHEEL_SLOTS-1)];
+
+	for (; *pp; pp = &(*pp)->next) {
+		if (*pp == c) {
+			*pp = c->next;
+			return;
+		}
+	}
+}
+
+// Set the compare for the earliest deadline:
+static void	wake_program(void)
+{
+	uint32_t now = (uint32_t)global_time;
+	int32_t dt = TIME_MAX_SLEEP_MS;
+	uint32_t ccr;
+
+	for (int s = 0; s < TIME_WHEEL_SLOTS; s++) {
+		for (time_callback_t *c = wheel[s]; c; c = c->next) {
+			if ((int32_t)(c->deadline - now) < dt)
+				dt = c->deadline - now;
+		}
 	}
+	if (dt < 1)
+		dt = 1;
+
+	ccr = ms_cnt + (uint32_t)dt * CYCLES_PER_MS;
+	TIM2->CCR1 = ccr;
+	/* If that's already gone by, the compare won't match for another
+	 * lap of TIM2, so fire now.  (By raising CC1IF, not just pending the
+	 * IRQ:  the handler ignores a wake without it.)  Measured from ms_cnt,
+	 * as a long sleep's more than half a lap, too far for a signed diff.
+	 */
+	if (TIM2->CNT - ms_cnt >= ccr - ms_cnt)
+		TIM2->EGR = TIM_EGR_CC1G;
 }
 
-void 	SysTick_Handler(void)
+void 	TIM2_IRQHandler(void)
 {
-	static int on = 0;
-	time_callback_t *c = cb_list;
+	uint32_t now;
+	int n;
+	time_callback_t **pp, *c;
+
+	if (TIM2->SR & TIM_SR_UIF) {
+		uint64_t us;
+		uint32_t rem;
 
-	on++;
+		__disable_irq();
+		wrap_seq++;
+		TIM2->SR = ~TIM_SR_UIF;
+		us = us_wrap;
+		rem = us_rem;
+		wrap_add(&us, &rem);
+		us_wrap = us;
+		us_rem = rem;
+		wrap_seq++;
+		__enable_irq();
+	}
+	if (!(TIM2->SR & TIM_SR_CC1IF))
+		return;
 
-	global_time++;
+	TIM2->SR = ~TIM_SR_CC1IF;
+	time_update();
+	now = (uint32_t)global_time;
 
-	/* Process callbacks */
-	while (c) {
-		if (c->next_tick <= global_time) {
-			c->callback(global_time);
-			c->next_tick += c->period;
+	/* Run the wheel over the ms since last time (each slot once at most,
+	 * if we've been away a lap or more).  Entries a lap or more away stay
+	 * put.  Due entries are queued to run in PendSV; a periodic one goes
+	 * back on the wheel (at the head of a slot, so if it's this one it's
+	 * skipped next time round).
+	 */
+	n = now - ms_done;
+	if (n > TIME_WHEEL_SLOTS)
+		n = TIME_WHEEL_SLOTS;
+	for (; n > 0; n--) {
+		pp = &wheel[(now - n + 1) & (TIME_WHEEL_SLOTS-1)];
+		while ((c = *pp)) {
+			if ((int32_t)(c->deadline - now) > 0) {
+				pp = &c->next;
+				continue;
+			}
+			*pp = c->next;
+			if (c->period)
+				wheel_add(c, c->deadline + c->period);
+			if (c->callback) {
+				c->work.fn = callback_work;
+				work_schedule(&c->work);
+			}
 		}
-		c = c->next;
 	}
+	ms_done = now;
+	wake_program();
+}
+
+static void	time_callback_add(time_callback_t *c, uint32_t ms)
+{
+	__disable_irq();
+	wheel_remove(c);
+	time_update();
+	wheel_add(c, (uint32_t)global_time + ms);
+	wake_program();
+	__enable_irq();
 }
 
 void 	time_callback_periodic(time_callback_t *c)
 {
-	c->next = cb_list;
-	cb_list = c;
+	time_callback_add(c, c->period);
+}
+
+void 	time_callback_once(time_callback_t *c, uint32_t ms)
+{
+	if (ms == 0)
+		ms = 1;		// Next ms, at the earliest
+	c->period = 0;
+	time_callback_add(c, ms);
+}
 
+void 	time_callback_cancel(time_callback_t *c)
+{
 	__disable_irq();
-	c->next_tick = global_time + c->period;
+	wheel_remove(c);
 	__enable_irq();
+	work_cancel(&c->work);
 }
 
 void 	time_init(void)
 {
-	SysTick_Config(48000000/1000);
+	work_init();
 
-	/* Set up TIM2 as 32bit upcounting for high-precision tickin' */
+	/* Set up TIM2 as 32bit upcounting for high-precision tickin', and
+	 * compare 1 to wake us for timers:
+	 */
 	RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
 
 	TIM2->ARR = 0xffffffff;
@@ -89,11 +303,20 @@ void 	time_init(void)
 	TIM2->SMCR = 0;
 	TIM2->DIER = 0;
 	TIM2->EGR = 0;
-	TIM2->CCMR1 = 0;
+	TIM2->CCMR1 = 0;	// Frozen; compare just sets CC1IF
 	TIM2->CCER = 0;
 	TIM2->CNT = 0;
 	TIM2->PSC = 0;
+	TIM2->CCR1 = TIME_MAX_SLEEP_MS * (uint32_t)CYCLES_PER_MS;
+	TIM2->SR = 0;
+	TIM2->DIER = TIM_DIER_CC1IE | TIM_DIER_UIE;
 	TIM2->CR1 = TIM_CR1_CEN; /* Enabled, upcounting, nothing fancy */
+
+	ms_cnt = 0;
+	ms_done = (uint32_t)global_time;
+
+	NVIC_SetPriority(TIM2_IRQn, IRQ_PRIO_TICK);
+	NVIC_EnableIRQ(TIM2_IRQn);
 }
 
 uint32_t time_getfine(void)
@@ -17,30 +17,88 @@
 #ifndef TIME_H
 #define TIME_H
 
+#include "work.h"
+
 void	delay_ms(int d);
+// Busy-waits on TIM2, so it's accurate (bar IRQs) from 1us up to ~89s:
 void	delay_us(int d);
 
-/* Get us? get ms?  global_time's not that accurate */
+/* Timer callbacks run every 'period' ms or (with period 0) once.  The timer
+ * IRQ just queues them as deferred work (work.h), so they run in PendSV.
+ * They're kept on a hashed timing wheel of TIME_WHEEL_SLOTS lists, by the
+ * low bits of their deadline; deadlines are the low 32 bits of global_time,
+ * compared wrap-safely.  There's no periodic tick:  the timer's only set to
+ * wake for the earliest deadline (see time.c).
+ */
+#define TIME_WHEEL_SLOTS	16	// Power of 2
 
 typedef struct _tcallback {
+	work_t work;			// Must be first
 	void (*callback)(uint64_t t_now);
-	uint64_t period;
-	uint64_t next_tick;
+	uint32_t period;		// ms, or 0 for one-shot
+	uint32_t deadline;
 	struct _tcallback *next;
 } time_callback_t;
 
 void	time_init(void);
+// Start c (with c->period and c->callback set), first firing after a period:
 void	time_callback_periodic(time_callback_t *c);
+// Fire c once, after 'ms':
+void	time_callback_once(time_callback_t *c, uint32_t ms);
+// Stop c, including a run that's due but not yet made (safe from a
+// callback, including c's own):
+void	time_callback_cancel(time_callback_t *c);
+// Raw TIM2 (48MHz core clock) count, for timing short things by difference:
 uint32_t time_getfine(void);
 
-extern volatile uint64_t global_time;
-#ifndef SIM
-static inline uint64_t time_getglobal(void)
+// ms since boot:
+uint64_t time_getglobal(void);
+// us since boot:  TIM2 extended by counting its wraps, without masking IRQs
+// (so OK from any IRQ):
+uint64_t time_getus(void);
+
+/* Conversions between ms, us and the RTC's sub-seconds:  the SSR register
+ * counts down from PREDIV_S, and tod_t's frac is in 1/65536s.  The 32-bit
+ * us/sub-second ones are for under a second; none of them divide.
+ */
+#define TIME_RTC_PREDIV_S	255	// Must match RTC_SynchPrediv in rtc.c
+
+static inline uint32_t time_ms_to_us(uint32_t ms)
 {
-	return global_time;
+	return ms * 1000;
+}
+
+static inline uint32_t time_us_to_ms(uint32_t us)
+{
+	// 2^32/1000 rounded down, which can come out one short:
+	uint32_t ms = ((uint64_t)us * 4294967) >> 32;
+
+	if (us - ms * 1000 >= 1000)
+		ms++;
+	return ms;
+}
+
+// (PREDIV_S - SS)/(PREDIV_S + 1) seconds:
+static inline uint32_t time_rtc_ss_to_us(uint32_t ss)
+{
+	return ((TIME_RTC_PREDIV_S - ss) * 15625) >> 2;
+}
+
+// SS value (rounded down to the step) for us into the second:
+static inline uint32_t time_us_to_rtc_ss(uint32_t us)
+{
+	return TIME_RTC_PREDIV_S - (((uint64_t)us * 4398047) >> 34);
+}
+
+static inline uint16_t time_us_to_frac(uint32_t us)
+{
+	// 2^52/10^6, rounded up (2^32 scale isn't quite enough for exact):
+	return ((uint64_t)us * 4503599628ULL) >> 36;
+}
+
+static inline uint32_t time_frac_to_us(uint16_t frac)
+{
+	return ((uint32_t)frac * 15625) >> 10;
 }
-#else
-uint64_t time_getglobal(void);
-#endif
 
 #endif
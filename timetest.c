@@ -0,0 +1,414 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * timetest:  time.c on the host, against a model of TIM2 and the NVIC.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stm32f0xx.h>
+#include "time.h"
+#include "hw.h"
+
+/* 'make check' builds time.c against sim_inc/stm32f0xx.h and runs this.
+ *
+ * The model:  a 64-bit cycle count (since time_init() zeroes CNT) stands in
+ * for the core clock, and every TIM2 access moves it on by a few cycles, so
+ * IRQs land part-way through time.c's reads and updates just as they would.
+ * The flags are rc_w0, CC1IF's set when the count passes CCR1 (or by
+ * EGR.CC1G), and the TIM2 IRQ is pended while a flag and its enable are set,
+ * or by NVIC_SetPendingIRQ(), and taken when IRQs are on.  Writes are seen
+ * at the next access.  Deferred work (work.h) runs in a PendSV stand-in once
+ * the TIM2 IRQ's done.
+ */
+#define CYCLES_PER_MS	(SYS_CLK / 1000)
+#define CYCLES_PER_US	(SYS_CLK / 1000000)
+
+RCC_TypeDef model_rcc;
+
+static TIM_TypeDef tim2;		// What time.c sees
+static uint64_t cyc;
+static uint32_t sr, ccr1;		// The model's own copies
+static uint32_t sr_shown, cnt_shown;	// What time.c was last shown
+static uint64_t stall, stall_end;
+static int primask, irq_en, irq_pend, in_tim2, in_pendsv;
+
+static unsigned int n_irqs, n_irqs_in_read, in_read;
+
+void	TIM2_IRQHandler(void);
+
+static uint32_t	rnd(void)
+{
+	static uint32_t x = 2463534242U;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static void	advance(uint64_t n)
+{
+	uint32_t cnt = (uint32_t)cyc;
+
+	if (!(tim2.CR1 & TIM_CR1_CEN))
+		return;
+	if ((uint32_t)(ccr1 - cnt - 1) < n)
+		sr |= TIM_SR_CC1IF;
+	if (cnt + n > 0xffffffffULL)
+		sr |= TIM_SR_UIF;
+	cyc += n;
+}
+
+// Pick up what time.c's written since the last access, and show it the count:
+static void	sync(void)
+{
+	if (tim2.SR != sr_shown)
+		sr &= tim2.SR;
+	if (tim2.CNT != cnt_shown)
+		cyc = tim2.CNT;
+	if (tim2.CCR1 != ccr1) {
+		// A stall lands just before the new compare takes effect:
+		if (stall) {
+			advance(stall);
+			stall_end = cyc;
+			stall = 0;
+		}
+		ccr1 = tim2.CCR1;
+	}
+	if (tim2.EGR & TIM_EGR_CC1G)
+		sr |= TIM_SR_CC1IF;
+	tim2.EGR = 0;
+
+	tim2.SR = sr_shown = sr;
+	tim2.CNT = cnt_shown = (uint32_t)cyc;
+	// (A flag that's still up when the IRQ returns pends it again.)
+	if (!in_tim2 && (sr & tim2.DIER & (TIM_SR_UIF | TIM_SR_CC1IF)))
+		irq_pend = 1;
+}
+
+/* work.h, as PendSV:  the lowest priority, so it runs when nothing else is
+ * and can be interrupted by TIM2.
+ */
+static work_t *work_head, **work_tail = &work_head;
+
+void	work_init(void)
+{
+}
+
+void	work_schedule(work_t *w)
+{
+	if (w->queued)
+		return;
+	w->queued = 1;
+	w->next = 0;
+	*work_tail = w;
+	work_tail = &w->next;
+}
+
+void	work_cancel(work_t *w)
+{
+	for (work_t **pp = &work_head; *pp; pp = &(*pp)->next) {
+		if (*pp == w) {
+			*pp = w->next;
+			if (!*pp)
+				work_tail = pp;
+			w->queued = 0;
+			return;
+		}
+	}
+}
+
+static void	take_irqs(void)
+{
+	while (irq_pend && irq_en && !primask && !in_tim2) {
+		irq_pend = 0;
+		in_tim2 = 1;
+		n_irqs++;
+		n_irqs_in_read += in_read;
+		TIM2_IRQHandler();
+		in_tim2 = 0;
+		sync();
+	}
+	if (primask || in_tim2 || in_pendsv)
+		return;
+	in_pendsv = 1;
+	while (work_head) {
+		work_t *w = work_head;
+
+		work_head = w->next;
+		if (!work_head)
+			work_tail = &work_head;
+		w->queued = 0;
+		w->fn(w);
+	}
+	in_pendsv = 0;
+}
+
+TIM_TypeDef	*model_tim2(void)
+{
+	sync();
+	advance(1 + (rnd() & 31));
+	sync();
+	take_irqs();
+	return &tim2;
+}
+
+void	NVIC_EnableIRQ(IRQn_Type irq)
+{
+	irq_en = 1;
+}
+
+void	NVIC_SetPendingIRQ(IRQn_Type irq)
+{
+	irq_pend = 1;
+}
+
+void	NVIC_SetPriority(IRQn_Type irq, uint32_t prio)
+{
+}
+
+void	__disable_irq(void)
+{
+	primask = 1;
+}
+
+void	__enable_irq(void)
+{
+	primask = 0;
+	sync();
+	take_irqs();
+}
+
+// Cycles to the next thing TIM2 would flag:
+static uint64_t	next_event(void)
+{
+	uint32_t cnt = (uint32_t)cyc;
+	uint64_t to_wrap = 0x100000000ULL - cnt;
+	uint64_t to_ccr = (uint32_t)(ccr1 - cnt);
+
+	if (to_ccr == 0 || to_ccr > to_wrap)
+		return to_wrap;
+	return to_ccr;
+}
+
+void	__WFI(void)
+{
+	sync();
+	while (!irq_pend) {
+		advance(next_event());
+		sync();
+	}
+	take_irqs();
+}
+
+// Let n cycles go by (doing nothing but IRQs):
+static void	run(uint64_t n)
+{
+	uint64_t end = cyc + n;
+
+	sync();
+	while (cyc < end) {
+		uint64_t d = next_event();
+
+		advance((d < end - cyc) ? d : end - cyc);
+		sync();
+		take_irqs();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static time_callback_t t5, t50, once;
+static unsigned int n5, n50, n_once;
+static uint64_t once_cyc;
+
+static void	cb5(uint64_t t_now)
+{
+	n5++;
+}
+
+static void	cb50(uint64_t t_now)
+{
+	n50++;
+}
+
+static void	cb_once(uint64_t t_now)
+{
+	n_once++;
+	once_cyc = cyc;
+}
+
+/* 200s of periodic and one-shot timers, with the timer only waking for
+ * deadlines:  the periodics fire as often as they should, the one-shot within
+ * a ms of its deadline, and global_time keeps up with the count.
+ */
+static int	test_tickless(void)
+{
+	uint64_t start_ms = time_getglobal();
+	uint64_t due_cyc = (start_ms + 1234) * CYCLES_PER_MS;
+	unsigned int irqs = n_irqs;
+	int bad = 0;
+
+	t5.period = 5;
+	t5.callback = cb5;
+	time_callback_periodic(&t5);
+	t50.period = 50;
+	t50.callback = cb50;
+	time_callback_periodic(&t50);
+	once.callback = cb_once;
+	time_callback_once(&once, 1234);
+
+	for (int s = 1; s <= 200; s++) {
+		uint64_t c0, c1, g;
+
+		run((start_ms + s * 1000) * CYCLES_PER_MS - cyc);
+		c0 = cyc;
+		g = time_getglobal();
+		c1 = cyc;
+		if (g < c0 / CYCLES_PER_MS || g > c1 / CYCLES_PER_MS)
+			bad++;
+	}
+	time_callback_cancel(&t5);
+	time_callback_cancel(&t50);
+
+	if (n5 != 200000 / 5 || n50 != 200000 / 50)
+		bad++;
+	if (n_once != 1 || once_cyc < due_cyc ||
+	    once_cyc - due_cyc >= CYCLES_PER_MS)
+		bad++;
+	printf("check tickless 200s: %d wrong (%u+%u periodic runs, "
+	       "%u TIM2 IRQs)\n", bad, n5, n50, n_irqs - irqs);
+	return bad;
+}
+
+/* A one-shot whose compare has gone by before it's written (something
+ * higher-priority took the CPU between time_update() and the CCR1 write)
+ * still has to fire straight away, not a TIM2 lap later.
+ */
+static time_callback_t late;
+static int late_fired;
+static uint64_t late_cyc;
+
+static void	cb_late(uint64_t t_now)
+{
+	late_fired = 1;
+	late_cyc = cyc;
+}
+
+static int	test_passed_compare(void)
+{
+	int bad = 0, n = 0;
+
+	late.callback = cb_late;
+	for (int i = 0; i < 1000; i++) {
+		run(rnd() % (2 * CYCLES_PER_MS));
+		late_fired = 0;
+		stall = CYCLES_PER_MS + rnd() % (2 * CYCLES_PER_MS);
+		stall_end = 0;
+		time_callback_once(&late, 1);
+		if (!stall_end) {
+			// (Compare unchanged, so no stall; try again.)
+			stall = 0;
+			time_callback_cancel(&late);
+			continue;
+		}
+		n++;
+		run(5 * CYCLES_PER_MS);
+		if (!late_fired || late_cyc - stall_end >= CYCLES_PER_MS)
+			bad++;
+		time_callback_cancel(&late);
+	}
+	printf("check compare already passed: %d of %d late\n", bad, n);
+	return bad;
+}
+
+static int	test_delay_ms(void)
+{
+	int bad = 0;
+
+	for (int i = 0; i < 200; i++) {
+		int d = 1 + rnd() % 20;
+		uint64_t c;
+
+		run(rnd() % CYCLES_PER_MS);
+		c = cyc;
+		delay_ms(d);
+		c = cyc - c;
+		if (c <= (uint64_t)(d - 1) * CYCLES_PER_MS ||
+		    c >= (uint64_t)(d + 1) * CYCLES_PER_MS)
+			bad++;
+	}
+	printf("check delay_ms: %d wrong\n", bad);
+	return bad;
+}
+
+/* time_getus() against the count over a few dozen TIM2 wraps:  with IRQs on
+ * (so the update IRQ can land in the middle of a read), and with IRQs off and
+ * the wrap not yet counted.
+ */
+static int	test_getus(void)
+{
+	uint64_t last = 0;
+	uint64_t wraps = cyc >> 32;
+	unsigned int pending = 0, mid = n_irqs_in_read;
+	int bad = 0;
+
+	for (int i = 0; i < 20000; i++) {
+		uint64_t c0, c1, us;
+		uint64_t to_wrap = 0x100000000ULL - (uint32_t)cyc;
+		int off = rnd() & 1;
+
+		// Half the time, up to just short of a wrap, so it lands in the
+		// read (or, with IRQs off, just before it):
+		if ((rnd() & 2) && to_wrap > 256)
+			run(to_wrap - 1 - rnd() % 256);
+		else
+			run(rnd() & 0x3fffff);
+		if (off) {
+			__disable_irq();
+			advance(rnd() % 256);
+			sync();
+			pending += !!(sr & TIM_SR_UIF);
+		}
+		c0 = cyc;
+		in_read = 1;
+		us = time_getus();
+		in_read = 0;
+		c1 = cyc;
+		if (off)
+			__enable_irq();
+		if (us < c0 / CYCLES_PER_US || us > c1 / CYCLES_PER_US ||
+		    us < last)
+			bad++;
+		last = us;
+	}
+	printf("check time_getus: %d wrong over %u wraps (%u reads with the "
+	       "wrap pending, %u interrupted)\n", bad,
+	       (unsigned int)((cyc >> 32) - wraps), pending,
+	       n_irqs_in_read - mid);
+	return bad;
+}
+
+int	main(void)
+{
+	int bad = 0;
+
+	time_init();
+	bad += test_tickless();
+	bad += test_passed_compare();
+	bad += test_delay_ms();
+	bad += test_getus();
+	return bad != 0;
+}
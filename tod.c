@@ -0,0 +1,91 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * tod:  Time of day counter for the accelerated clocks (see tod.h).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tod.h"
+#include "time.h"
+
+// x/10^6 for any 32-bit x:  2^50/10^6, rounded up, is close enough that the
+// error never reaches the next integer.
+static inline uint32_t	div_1e6(uint32_t x)
+{
+	return ((uint64_t)x * 1125899907ULL) >> 50;
+}
+
+// x/60 for x < 43690 (2^21/60 rounded up); a step's at most 3600+59 secs.
+static inline uint32_t	div_60(uint32_t x)
+{
+	return (x * 34953) >> 21;
+}
+
+void	tod_counter_set(tod_counter_t *c, uint8_t hour, uint8_t min,
+			uint8_t sec, uint32_t us)
+{
+	c->hour = hour;
+	c->min = min;
+	c->sec = sec;
+	c->us = us;
+}
+
+void	tod_counter_step(tod_counter_t *c, uint32_t us)
+{
+	uint32_t s, m, h;
+
+	// Up to TOD_MAX_STEP_US, so this doesn't overflow:
+	us += c->us;
+	if (us < 1000000) {
+		c->us = us;
+		return;
+	}
+	s = div_1e6(us);
+	c->us = us - s * 1000000;
+
+	s += c->sec;
+	if (s < 60) {
+		c->sec = s;
+		return;
+	}
+	m = div_60(s);
+	c->sec = s - m * 60;
+
+	m += c->min;
+	if (m < 60) {
+		c->min = m;
+		return;
+	}
+	h = div_60(m);
+	c->min = m - h * 60;
+
+	h += c->hour;
+	while (h >= 24)
+		h -= 24;
+	c->hour = h;
+}
+
+void	tod_counter_get(const tod_counter_t *c, tod_t *time_out)
+{
+	time_out->hour = c->hour;
+	time_out->amnpm = 1;
+	if (time_out->hour > 11) {
+		time_out->hour -= 12;
+		time_out->amnpm = 0;
+	}
+	time_out->min = c->min;
+	time_out->sec = c->sec;
+	time_out->frac = time_us_to_frac(c->us);
+	time_out->subsec = time_out->frac >> 10;
+}
@@ -0,0 +1,47 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOD_H
+#define TOD_H
+
+#include <inttypes.h>
+#include "rtc.h"
+
+/* A time of day that's stepped on, rather than worked out from a count of
+ * microseconds with 64-bit divides (which the M0 does in software, slowly).
+ * Used for the accelerated clocks:  rtc.c's fast mode and the sim's
+ * RUN_FAST.
+ *
+ * A step's carried up through the fields; under a second, that's an add and
+ * a compare.  Bigger steps (the speed multiplier's applied before stepping)
+ * are split with multiply-shift reciprocals, so any step up to an hour costs
+ * about the same.
+ */
+typedef struct {
+	uint32_t	us;	// 0-999999
+	uint8_t		sec;	// 0-59
+	uint8_t		min;	// 0-59
+	uint8_t		hour;	// 0-23
+} tod_counter_t;
+
+#define TOD_MAX_STEP_US		3600000000U
+
+void	tod_counter_set(tod_counter_t *c, uint8_t hour, uint8_t min,
+			uint8_t sec, uint32_t us);
+void	tod_counter_step(tod_counter_t *c, uint32_t us);
+void	tod_counter_get(const tod_counter_t *c, tod_t *time_out);
+
+#endif
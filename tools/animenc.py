@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+#
+# animenc:  Encode ring animations for anim.c (see anim.h for the format).
+#
+# Copyright (c) 2014 Matt Evans
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Usage:
+#	animenc.py a.anim > a.bin
+#
+# (tools/mkassets.py uses this to put animations in the asset image.)
+#
+# Source files are text:  '# comments', 'period <ms>', 'loop <0|1>', then
+# one 'frame' line per frame of 60 pixels, each 'rrggbb' (hex) or '.' for
+# transparent (the face shows through when played over it).
+
+import sys
+
+PIXELS = 60
+MAX_CHAIN = 8		# Must match ANIM_MAX_CHAIN
+
+OP_SKIP = 0x00
+OP_RUN = 0x40
+OP_LIT = 0x80
+OP_END = 0xc0
+FR_KEY = 0x80
+FL_LOOP = 1
+
+
+class EncError(Exception):
+	pass
+
+
+def parse(text, name):
+	period, loop, frames = 33, 0, []
+	for lineno, line in enumerate(text.splitlines(), 1):
+		line = line.split("#")[0].split()
+		if not line:
+			continue
+		try:
+			if line[0] == "period":
+				period = int(line[1])
+				if not 1 <= period <= 255:
+					raise EncError("period must be 1-255ms")
+			elif line[0] == "loop":
+				loop = int(line[1])
+			elif line[0] == "frame":
+				if len(line) != PIXELS + 1:
+					raise EncError("frame needs %d pixels" % PIXELS)
+				frames.append([None if p == "." else
+					       tuple(bytes.fromhex(p)) for p in line[1:]])
+			else:
+				raise EncError("unknown keyword '%s'" % line[0])
+		except (ValueError, IndexError):
+			raise EncError("%s:%d: bad line" % (name, lineno))
+		except EncError as e:
+			raise EncError("%s:%d: %s" % (name, lineno, e))
+	if not frames or len(frames) > 0xffff:
+		raise EncError("%s: need 1-65535 frames" % name)
+	return period, loop, frames
+
+
+# Emit ops for the pixels marked in 'draw' (others skipped):
+def encode_ops(pix, draw):
+	out = []
+	i = 0
+	while i < PIXELS:
+		j = i
+		if not draw[i]:
+			while j < PIXELS and not draw[j]:
+				j += 1
+			if j < PIXELS:
+				out.append(OP_SKIP | (j - i - 1))
+		elif i + 1 < PIXELS and draw[i + 1] and pix[i + 1] == pix[i]:
+			while j < PIXELS and draw[j] and pix[j] == pix[i]:
+				j += 1
+			out += [OP_RUN | (j - i - 1)] + list(pix[i])
+		else:
+			# Literals up to the next run of 2 (or skip):
+			while j < PIXELS and draw[j] and \
+			      not (j + 1 < PIXELS and draw[j + 1] and pix[j + 1] == pix[j]):
+				j += 1
+			if j == i:
+				j = i + 1
+			out.append(OP_LIT | (j - i - 1))
+			for p in pix[i:j]:
+				out += list(p)
+		i = j
+	return out + [OP_END]
+
+
+def encode(period, loop, frames):
+	out = [period, FL_LOOP if loop else 0, len(frames) & 0xff, len(frames) >> 8]
+	prev = None
+	chain = 0
+	for f in frames:
+		# A keyframe is needed to start, to bound the decode chain, and
+		# whenever a pixel goes back to transparent (a delta can't
+		# restore what the face drew underneath).
+		key = prev is None or chain == MAX_CHAIN - 1 or \
+		      any(p is None and q is not None for p, q in zip(f, prev))
+		if key:
+			out.append(FR_KEY)
+			out += encode_ops(f, [p is not None for p in f])
+			chain = 0
+		else:
+			out.append(0)
+			out += encode_ops(f, [p != q for p, q in zip(f, prev)])
+			chain += 1
+		prev = f
+	return bytes(out)
+
+
+def main(argv):
+	if len(argv) != 2:
+		sys.stderr.write("usage: %s file.anim\n" % argv[0])
+		return 1
+	try:
+		period, loop, frames = parse(open(argv[1]).read(), argv[1])
+		data = encode(period, loop, frames)
+	except EncError as e:
+		sys.stderr.write("%s\n" % e)
+		return 1
+	sys.stderr.write("%d frames, %d bytes (%d raw)\n" %
+			 (len(frames), len(data), len(frames) * PIXELS * 3))
+	sys.stdout.buffer.write(data)
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+#
+# fvasm:  Assembler/disassembler for bytecode faces (see facevm.h).
+#
+# Copyright (c) 2014 Matt Evans
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Usage:
+#	fvasm.py -b a.fvs > a.bin		Raw bytecode
+#	fvasm.py -d a.bin			Disassemble
+#
+# (tools/mkassets.py uses this to put faces in the asset image.)
+#
+# Source is one instruction per line, '; comments', 'label:' and registers
+# r0-r15, e.g.
+#
+#	time	r0, sec
+#	ldi	r1, 21
+#	ramp	rg, 12, r0, r1		; mask, count, pos, step
+#	jnz	r1, label
+#
+# An 'end' is always appended.
+
+import sys
+
+# Must match the enums in facevm.h.  Operand kinds:  r = register,
+# i = signed 16-bit immediate, n = 0-31 shift, f = time field, l = label,
+# m = channel mask, M = mask and ramp count.
+OPS = [
+	("end",		""),
+	("ldi",		"ri"),
+	("time",	"rf"),
+	("add",		"rrr"),
+	("sub",		"rrr"),
+	("mul",		"rrr"),
+	("and",		"rrr"),
+	("shr",		"rrn"),
+	("shl",		"rrn"),
+	("sin",		"rr"),
+	("jz",		"rl"),
+	("jnz",		"rl"),
+	("fill",	"rrr"),
+	("ramp",	"Mrr"),
+	("set",		"mrr"),
+	("addp",	"mrr"),
+	("ticks",	"r"),
+]
+OPNUM = dict((name, i) for i, (name, _) in enumerate(OPS))
+FIELDS = ["hour", "min", "sec", "anim", "param"]
+
+
+class AsmError(Exception):
+	pass
+
+
+def reg(s):
+	if s[0] != "r" or not s[1:].isdigit() or int(s[1:]) > 15:
+		raise AsmError("bad register '%s'" % s)
+	return int(s[1:])
+
+
+def num(s, lo, hi):
+	try:
+		v = int(s, 0)
+	except ValueError:
+		raise AsmError("bad number '%s'" % s)
+	if v < lo or v > hi:
+		raise AsmError("%d out of range %d-%d" % (v, lo, hi))
+	return v
+
+
+def mask(s):
+	m = 0
+	for ch in s:
+		if ch not in "rgb":
+			raise AsmError("bad channel mask '%s'" % s)
+		m |= 1 << "rgb".index(ch)
+	return m
+
+
+def imm16(v):
+	v &= 0xffff
+	return [v & 0xff, v >> 8]
+
+
+def assemble(text, name="<input>"):
+	lines = []
+	labels = {}
+	for lineno, line in enumerate(text.splitlines(), 1):
+		line = line.split(";")[0].strip()
+		while ":" in line:
+			label, line = line.split(":", 1)
+			labels[label.strip()] = len(lines)
+			line = line.strip()
+		if line:
+			lines.append((lineno, line))
+	lines.append((0, "end"))
+
+	out = []
+	for pc, (lineno, line) in enumerate(lines):
+		try:
+			parts = line.split(None, 1)
+			op = parts[0].lower()
+			args = [a.strip() for a in parts[1].split(",")] if len(parts) > 1 else []
+			if op not in OPNUM:
+				raise AsmError("unknown op '%s'" % op)
+			kinds = OPS[OPNUM[op]][1]
+			if "M" in kinds:
+				kinds = "mn" + kinds[1:]
+			if len(args) != len(kinds):
+				raise AsmError("%s takes %d operands" % (op, len(kinds)))
+			ops = []
+			for k, a in zip(kinds, args):
+				if k == "r":
+					ops.append(reg(a))
+				elif k == "i":
+					ops += imm16(num(a, -32768, 32767))
+				elif k == "n":
+					ops.append(num(a, 0, 31))
+				elif k == "f":
+					if a not in FIELDS:
+						raise AsmError("unknown time field '%s'" % a)
+					ops.append(FIELDS.index(a))
+				elif k == "m":
+					ops.append(mask(a))
+				elif k == "l":
+					if a not in labels:
+						raise AsmError("unknown label '%s'" % a)
+					ops += imm16(labels[a] - (pc + 1))
+			if op == "ramp":
+				ops = [ops[0] | (ops[1] << 3)] + ops[2:]
+			ops = (ops + [0, 0, 0])[:3]
+			out += [OPNUM[op]] + ops
+		except AsmError as e:
+			raise AsmError("%s:%d: %s" % (name, lineno, e))
+	return bytes(out)
+
+
+def disassemble(code):
+	lines = []
+	targets = set()
+	for pc in range(0, len(code) - 3, 4):
+		op, a, b, c = code[pc:pc + 4]
+		imm = (b | c << 8) - ((b | c << 8) & 0x8000) * 2
+		if op >= len(OPS):
+			lines.append(".byte %d, %d, %d, %d" % (op, a, b, c))
+			continue
+		name, kinds = OPS[op]
+		if kinds == "Mrr":
+			args = ["".join(ch for i, ch in enumerate("rgb") if a & (1 << i)) or "0",
+				str(a >> 3), "r%d" % b, "r%d" % c]
+		else:
+			args = []
+			vals = [a, b, c]
+			for k in kinds:
+				v = vals.pop(0)
+				if k == "r":
+					args.append("r%d" % (v & 15))
+				elif k == "i":
+					args.append(str(imm))
+				elif k == "n":
+					args.append(str(v))
+				elif k == "f":
+					args.append(FIELDS[v] if v < len(FIELDS) else str(v))
+				elif k == "m":
+					args.append("".join(ch for i, ch in enumerate("rgb") if v & (1 << i)) or "0")
+				elif k == "l":
+					t = pc // 4 + 1 + imm
+					targets.add(t)
+					args.append("L%d" % t)
+		lines.append(("%s\t%s" % (name, ", ".join(args))).rstrip())
+	out = []
+	for i, l in enumerate(lines):
+		if i in targets:
+			out.append("L%d:" % i)
+		out.append("\t" + l)
+	return "\n".join(out) + "\n"
+
+
+def main(argv):
+	if len(argv) < 3 or argv[1] not in ("-b", "-d"):
+		sys.stderr.write("usage: %s -b|-d file...\n" % argv[0])
+		return 1
+	mode, files = argv[1], argv[2:]
+	try:
+		for f in files:
+			if mode == "-d":
+				sys.stdout.write(disassemble(open(f, "rb").read()))
+			else:
+				sys.stdout.buffer.write(assemble(open(f).read(), f))
+	except AsmError as e:
+		sys.stderr.write("%s\n" % e)
+		return 1
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+#
+# mkassets:  Build the flash asset image (see assets.h for the format).
+#
+# Copyright (c) 2014 Matt Evans
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Usage:
+#	mkassets.py manifest.txt assets.bin assets_img.c
+#
+# The manifest lists one asset per line:  'id kind source'.  Kinds:
+#	s16	Whitespace-separated numbers, stored as 16-bit signed
+#	pal	Palette, 'rrggbb' hex colours (stored as pix_t[])
+#	face	Bytecode face source (tools/fvasm.py)
+#	anim	Animation source (tools/animenc.py)
+#	bin	Raw file
+#
+# assets.bin can be flashed on its own to ASSETS_BASE; assets_img.c is the
+# same image as a C array, linked into the .assets section of the firmware
+# (and used directly by the sim).
+
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import animenc
+import fvasm
+
+MAGIC = 0x53414343		# 'CCAS'
+VERSION = 1			# Must match ASSET_VERSION
+REGION_SIZE = 4096		# Must match the ASSETS region in stm32f051x6.ld
+ALIGN = 4			# assets_init() rejects entries that aren't
+
+
+class AssetError(Exception):
+	pass
+
+
+def text_tokens(path):
+	out = []
+	for line in open(path):
+		out += line.split("#")[0].split()
+	return out
+
+
+def load(kind, path):
+	if kind == "s16":
+		return b"".join(struct.pack("<h", int(t, 0)) for t in text_tokens(path))
+	if kind == "pal":
+		return b"".join(bytes.fromhex(t) for t in text_tokens(path))
+	if kind == "face":
+		return fvasm.assemble(open(path).read(), path)
+	if kind == "anim":
+		return animenc.encode(*animenc.parse(open(path).read(), path))
+	if kind == "bin":
+		return open(path, "rb").read()
+	raise AssetError("unknown kind '%s'" % kind)
+
+
+def build(manifest):
+	blobs = []
+	for lineno, line in enumerate(open(manifest), 1):
+		f = line.split("#")[0].split()
+		if not f:
+			continue
+		if len(f) != 3 or not f[0].isdigit():
+			raise AssetError("%s:%d: want 'id kind source'" % (manifest, lineno))
+		if int(f[0]) != len(blobs):
+			raise AssetError("%s:%d: IDs must run from 0 in order" % (manifest, lineno))
+		try:
+			blobs.append(load(f[1], f[2]))
+		except (IOError, ValueError, fvasm.AsmError, animenc.EncError) as e:
+			raise AssetError("%s:%d: %s" % (manifest, lineno, e))
+
+	# Header, offset table, then the blobs each padded out to ALIGN, so
+	# the next starts on a word (they're read in place, and the M0 faults
+	# on unaligned loads):
+	pos = 16 + 8 * len(blobs)
+	table = b""
+	body = b""
+	for b in blobs:
+		table += struct.pack("<II", pos + len(body), len(b))
+		body += b + b"\0" * (-len(b) % ALIGN)
+	rest = table + body
+	size = 16 + len(rest)
+	if size > REGION_SIZE:
+		raise AssetError("image is %d bytes, region is %d" % (size, REGION_SIZE))
+	words = struct.unpack("<%dI" % (len(rest) // 4), rest)
+	csum = sum(words) & 0xffffffff
+	hdr = struct.pack("<IIII", MAGIC, VERSION | (len(blobs) << 16), size, csum)
+	return hdr + rest, blobs
+
+
+def main(argv):
+	if len(argv) != 4:
+		sys.stderr.write("usage: %s manifest.txt out.bin out.c\n" % argv[0])
+		return 1
+	try:
+		img, blobs = build(argv[1])
+	except AssetError as e:
+		sys.stderr.write("%s\n" % e)
+		return 1
+	open(argv[2], "wb").write(img)
+	with open(argv[3], "w") as o:
+		o.write("/* Generated by tools/mkassets.py from %s; don't edit. */\n\n" % argv[1])
+		o.write('#include "assets.h"\n\n')
+		o.write("// %d assets, %d bytes\n" % (len(blobs), len(img)))
+		o.write("ASSET_SECTION const uint32_t asset_image[] = {\n")
+		for i in range(0, len(img), 16):
+			w = struct.unpack("<%dI" % (min(16, len(img) - i) // 4), img[i:i + 16])
+			o.write("\t%s,\n" % ", ".join("0x%08x" % x for x in w))
+		o.write("};\n")
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
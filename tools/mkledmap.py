@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+#
+# mkledmap:  Generate the pixel to driver bit table used by the LED encoder
+# (see ledmap.h).
+#
+# Copyright (c) 2014 Matt Evans
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Usage:
+#	mkledmap.py [-p rev] [-d drivers] [-r rotate] [-m] ledmap.c
+#
+#	-p	PCB revision (default 1)
+#	-d	Chained drivers, as RING_DRIVERS (default 4)
+#	-r	Minute marks the clock is turned clockwise from hanging with
+#		the MCU at 6 o'clock (default 0)
+#	-m	Mirrored (board mounted facing the other way)
+#
+# The table's checked before it's written:  every pixel lands on a distinct
+# driver output, the channels match the revision's bit map, and pixel 0 is
+# at 12 o'clock.
+
+import getopt
+import sys
+
+GROUP = 5		# Must match RING_GROUP
+THIRDS = 3		# Must match RING_THIRDS
+
+# Per revision:  each driver's output bit for R, G and B of the LEDs in its
+# group, and the LED at 12 o'clock (as a function of the pixel count) with
+# the MCU hung at the bottom.
+#
+# LEDs count round from the MCU's quadrant, with the first in the chain
+# (word 0 of a burst) driving the last (most clockwise) quadrant.  On rev 1
+# the 12 o'clock pixel is the centre of the third quadrant:  LED 36 of 60.
+REVS = {
+	1: {
+		"bits": [
+			[12, 10, 6, 3, 0],	# R
+			[13, 9, 7, 4, 1],	# G
+			[14, 8, 11, 5, 2],	# B
+		],
+		"top": lambda pixels: 7 * (pixels // 60) + pixels // 2,
+	},
+}
+
+
+class MapError(Exception):
+	pass
+
+
+# LED (as numbered round the board) to third, word and group position:
+def led_pos(led, drivers):
+	quad = led // (THIRDS * GROUP)
+	rem = led % (THIRDS * GROUP)
+	return rem // GROUP, drivers - 1 - quad, rem % GROUP
+
+
+def build(rev, drivers, rotate, mirror):
+	if rev not in REVS:
+		raise MapError("unknown PCB revision %d" % rev)
+	pixels = drivers * THIRDS * GROUP
+	if drivers < 1 or pixels % 60:
+		raise MapError("%d drivers don't make a multiple of 60 pixels" % drivers)
+	mult = pixels // 60
+	r = REVS[rev]
+	out = []
+	for p in range(pixels):
+		pos = (pixels - p) % pixels if mirror else p
+		led = (pos - rotate * mult + r["top"](pixels)) % pixels
+		third, word, i = led_pos(led, drivers)
+		out.append((third, word, [1 << r["bits"][c][i] for c in range(3)], led))
+	check(out, r, drivers, rotate, mirror)
+	return out
+
+
+def check(table, r, drivers, rotate, mirror):
+	pixels = len(table)
+	used = set()
+	for p, (third, word, masks, led) in enumerate(table):
+		if not (0 <= third < THIRDS and 0 <= word < drivers):
+			raise MapError("pixel %d: bad third/word" % p)
+		for c, m in enumerate(masks):
+			if m & (m - 1) or not m or m >= 0x10000:
+				raise MapError("pixel %d: mask %#x isn't one driver bit" % (p, m))
+			if (m.bit_length() - 1) not in r["bits"][c]:
+				raise MapError("pixel %d: bit %#x isn't a %s output" %
+					       (p, m, "RGB"[c]))
+			key = (third, word, m)
+			if key in used:
+				raise MapError("pixel %d: output used twice" % p)
+			used.add(key)
+	if len(used) != pixels * 3:
+		raise MapError("not every output is mapped")
+	# Pixel 0 is on the 12 o'clock LED once turned, and neighbours are
+	# neighbours (the right way round):
+	mult = pixels // 60
+	if table[0][3] != (r["top"](pixels) - rotate * mult) % pixels:
+		raise MapError("pixel 0 isn't at 12 o'clock")
+	step = -1 if mirror else 1
+	for p in range(pixels):
+		if (table[p][3] + step) % pixels != table[(p + 1) % pixels][3]:
+			raise MapError("pixels %d and %d aren't adjacent" % (p, p + 1))
+
+
+def main(argv):
+	try:
+		opts, args = getopt.getopt(argv[1:], "p:d:r:m")
+		if len(args) != 1:
+			raise getopt.GetoptError("want one output file")
+		o = dict(opts)
+		rev = int(o.get("-p", 1))
+		drivers = int(o.get("-d", 4))
+		rotate = int(o.get("-r", 0))
+		mirror = "-m" in o
+		table = build(rev, drivers, rotate, mirror)
+	except (getopt.GetoptError, ValueError) as e:
+		sys.stderr.write("%s\nusage: %s [-p rev] [-d drivers] [-r rotate] [-m] ledmap.c\n" %
+				 (e, argv[0]))
+		return 1
+	except MapError as e:
+		sys.stderr.write("%s\n" % e)
+		return 1
+	with open(args[0], "w") as o:
+		o.write("/* Generated by tools/mkledmap.py %s; don't edit. */\n\n" %
+			" ".join(argv[1:-1]))
+		o.write('#include "ledmap.h"\n\n')
+		o.write("#if RING_PIXELS != %d\n" % len(table))
+		o.write('#error "ledmap.c was made for %d pixels; rebuild it"\n' % len(table))
+		o.write("#endif\n\n")
+		o.write("// PCB rev %d, turned %d marks%s:\n" %
+			(rev, rotate, ", mirrored" if mirror else ""))
+		o.write("const led_map_t led_map[RING_PIXELS] = {\n")
+		for p, (third, word, masks, led) in enumerate(table):
+			o.write("\t{ %d, %d, { 0x%04x, 0x%04x, 0x%04x } },\t// %d: LED %d\n" %
+				((third, word) + tuple(masks) + (p, led)))
+		o.write("};\n")
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
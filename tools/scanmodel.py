@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+#
+# scanmodel:  Model the LED scan timing (see led_timing.h) for a range of
+# driver chain lengths, reporting the refresh rate each would get.
+#
+# Copyright (c) 2014 Matt Evans
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Usage:
+#	scanmodel.py [spi_max_hz]		(or 'make scanmodel')
+#
+# The constants are read from led_timing.h and hw.h, so this follows any
+# changes there; the sums are the same as the preprocessor's.
+
+import os
+import re
+import sys
+
+RAM_BUDGET = 3120	# pwm_data for the stock ring, about all the F051 can spare
+
+
+def defines(*files):
+	d = {}
+	for f in files:
+		for line in open(f):
+			m = re.match(r"#define\s+(\w+)\s+(\d+)\b", line)
+			if m:
+				d[m.group(1)] = int(m.group(2))
+	return d
+
+
+def model(c, drivers, spi_max):
+	sys_clk = c["SYS_CLK"]
+	br = 0
+	while br < 7 and spi_max < sys_clk // (2 << br):
+		br += 1
+	div = 2 << br
+	steps = 1 << c["PWM_SHIFT"]
+	ticks = 3 * (steps + c["PWM_DEAD_TIME"])
+	burst = drivers * 16 * div + c["LED_TICK_OVERHEAD"]
+	fit = (sys_clk // 4 * 3) // (ticks * burst)
+	hz = min(fit, c["PWM_REFRESH_MAX_HZ"])
+	tick = sys_clk // (hz * ticks) if hz else 0
+	ram = 2 * 3 * drivers * (steps + c["PWM_DEAD_TIME"]) * 2
+	return div, hz, burst, tick, ram
+
+
+def main(argv):
+	top = os.path.join(os.path.dirname(argv[0]), "..")
+	c = defines(os.path.join(top, "led_timing.h"), os.path.join(top, "hw.h"))
+	spi_max = int(argv[1]) if len(argv) > 1 else c["LED_SPI_MAX_HZ"]
+
+	print("SPI max %.1fMHz, %d PWM steps, refresh %d-%dHz" %
+	      (spi_max / 1e6, 1 << c["PWM_SHIFT"], c["PWM_REFRESH_MIN_HZ"],
+	       c["PWM_REFRESH_MAX_HZ"]))
+	print("drivers pixels  SPI    burst/tick(cyc)  refresh  pwm_data")
+	for drivers in (4, 8, 12, 16, 20, 24, 32, 40, 48):
+		div, hz, burst, tick, ram = model(c, drivers, spi_max)
+		if hz < c["PWM_REFRESH_MIN_HZ"]:
+			note = "too long (#error)"
+		elif ram > RAM_BUDGET:
+			note = "needs more RAM"
+		else:
+			note = ""
+		print("%5d %7d  %2dMHz  %5d/%-6d  %5dHz  %6d  %s" %
+		      (drivers, drivers * 15, c["SYS_CLK"] // div // 1000000,
+		       burst, tick, hz, ram, note))
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
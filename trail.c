@@ -0,0 +1,54 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * trail:  Accumulation buffer for motion trails/comet tails.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "geometry.h"
+#include "trail.h"
+
+static pix_t	acc[RING_PIXELS];
+
+void	trail_reset(void)
+{
+	uint8_t *a = &acc[0].r;
+
+	for (int i = 0; i < RING_PIXELS*3; i++)
+		a[i] = 0;
+}
+
+// No multiplies or divides; the M0 would manage the former but it isn't
+// needed.  Exponential decay, with a minimum step of 1 so the tail ends
+// rather than sitting at a dim floor of 2^shift-1.
+static inline uint8_t decay(uint8_t a, int shift)
+{
+	int d = (a >> shift) + 1;
+	return (a > d) ? a - d : 0;
+}
+
+void	trail_apply(pix_t *fb, int shift)
+{
+	uint8_t *a = &acc[0].r;
+	uint8_t *f = &fb[0].r;
+
+	for (int i = 0; i < RING_PIXELS*3; i++) {
+		uint8_t v = decay(a[i], shift);
+		if (f[i] > v)
+			v = f[i];
+		a[i] = v;
+		f[i] = v;
+	}
+}
@@ -0,0 +1,30 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRAIL_H
+#define TRAIL_H
+
+#include "types.h"
+
+/* Motion trails:  a persistent copy of the last output frame is decayed by
+ * 1/2^shift (plus one step, so it reaches black) and the new frame fb is
+ * composited on top, per channel, by max().  fb is replaced with the result.
+ * Costs one framebuffer's worth of RAM.
+ */
+void	trail_reset(void);
+void	trail_apply(pix_t *fb, int shift);
+
+#endif
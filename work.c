@@ -0,0 +1,118 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * work:  Deferred work queue, drained in PendSV (see work.h).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stm32f0xx.h>
+
+#include "work.h"
+#include "time.h"
+#include "uart.h"	// for printf
+
+static work_t	*head;
+static work_t	*tail;
+static int	depth;
+static work_stats_t stats;
+
+void	work_init(void)
+{
+	NVIC_SetPriority(PendSV_IRQn, IRQ_PRIO_WORK);
+}
+
+void	work_schedule(work_t *w)
+{
+	__disable_irq();
+	if (!w->queued) {
+		w->queued = 1;
+		w->next = 0;
+		if (tail)
+			tail->next = w;
+		else
+			head = w;
+		tail = w;
+		if (++depth > stats.max_depth)
+			stats.max_depth = depth;
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+	__enable_irq();
+}
+
+void	work_cancel(work_t *w)
+{
+	work_t **pp, *prev = 0;
+
+	__disable_irq();
+	for (pp = &head; *pp; prev = *pp, pp = &(*pp)->next) {
+		if (*pp == w) {
+			*pp = w->next;
+			if (tail == w)
+				tail = prev;
+			w->queued = 0;
+			depth--;
+			break;
+		}
+	}
+	__enable_irq();
+}
+
+void	work_get_stats(work_stats_t *s, int reset)
+{
+	__disable_irq();
+	*s = stats;
+	if (reset) {
+		stats.max_depth = depth;
+		stats.max_cycles = 0;
+		stats.runs = 0;
+	}
+	__enable_irq();
+}
+
+void	PendSV_Handler(void)
+{
+	uint32_t t = time_getfine();
+	work_t *w;
+
+	for (;;) {
+		__disable_irq();
+		w = head;
+		if (w) {
+			head = w->next;
+			if (!head)
+				tail = 0;
+			w->queued = 0;
+			depth--;
+		}
+		__enable_irq();
+		if (!w)
+			break;
+		w->fn(w);
+		stats.runs++;
+	}
+
+	t = time_getfine() - t;
+	if (t > stats.max_cycles)
+		stats.max_cycles = t;
+}
+
+// Print the stats every few seconds (from the main loop):
+void	work_debug(void)
+{
+	work_stats_t s;
+
+	work_get_stats(&s, 1);
+	printf("work: %d runs, max depth %d, max drain %d cycles\r\n",
+	       (int)s.runs, s.max_depth, (int)s.max_cycles);
+}
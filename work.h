@@ -0,0 +1,64 @@
+/* Copyright (c) 2014 Matt Evans
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORK_H
+#define WORK_H
+
+#include <inttypes.h>
+
+/* Deferred work, run in PendSV at the lowest priority.  IRQ handlers grab
+ * their data and schedule a work item to deal with it, so they're short and
+ * the LED scan IRQs (priority 0) aren't held up behind them.
+ *
+ * Priorities:
+ *	0	LED scan (TIM14, DMA)
+ *	1	-
+ *	2	TIM2 (timers, time.c), ADC, RTC alarm
+ *	3	PendSV (work)
+ *
+ * Items run in the order scheduled, each with IRQs on.  Scheduling an item
+ * that's already queued does nothing (so a late periodic timer is coalesced
+ * rather than queued twice).
+ */
+
+#define IRQ_PRIO_SCAN	0
+#define IRQ_PRIO_TICK	2
+#define IRQ_PRIO_WORK	3
+
+typedef struct _work {
+	void (*fn)(struct _work *w);
+	struct _work *next;
+	volatile uint8_t queued;
+} work_t;
+
+void	work_init(void);
+// From anywhere:
+void	work_schedule(work_t *w);
+// Unqueue w if it hasn't run yet:
+void	work_cancel(work_t *w);
+
+// Most items queued at once, and longest drain (in 48MHz cycles) since the
+// last reset:
+typedef struct {
+	uint8_t		max_depth;
+	uint32_t	max_cycles;
+	uint32_t	runs;
+} work_stats_t;
+
+void	work_get_stats(work_stats_t *s, int reset);
+void	work_debug(void);
+
+#endif